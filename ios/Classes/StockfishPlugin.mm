@@ -9,6 +9,19 @@
     stockfish_main();
     stockfish_stdin_write(NULL);
     stockfish_stdout_read();
+    stockfish_engine_destroy(stockfish_engine_create());
+    stockfish_engine_command(NULL, NULL);
+    stockfish_engine_poll(NULL, 0);
+    stockfish_engine_events_open(NULL, 0);
+    stockfish_engine_events_read(NULL, NULL, 0);
+    stockfish_engine_events_dropped(NULL);
+    stockfish_engine_evaluate(NULL, NULL, 0, NULL);
+    stockfish_engine_save_hash(NULL, NULL, 0);
+    stockfish_engine_load_hash(NULL, NULL);
+    stockfish_engine_tt_stats(NULL, 0, NULL);
+    stockfish_engine_ponder_stats(NULL, 0, NULL);
+    stockfish_engine_startup_stats(NULL, NULL);
+    stockfish_board_replay(NULL, 0, NULL, NULL, 0);
   }
 }
 
@@ -0,0 +1,221 @@
+#include "board.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <sstream>
+
+#include "../Stockfish/src/bitboard.h"
+#include "../Stockfish/src/movegen.h"
+#include "../Stockfish/src/uci.h"
+#include "events.h"
+
+namespace Stockfish
+{
+
+  namespace
+  {
+
+    std::once_flag initFlag;
+
+    bool is_uci_move(const std::string &s)
+    {
+      return (s.size() == 4 || s.size() == 5) && s[0] >= 'a' && s[0] <= 'h' && s[1] >= '1' && s[1] <= '8' &&
+             s[2] >= 'a' && s[2] <= 'h' && s[3] >= '1' && s[3] <= '8';
+    }
+
+    // Move numbers ("12." or "12..."), NAGs ("$1") and game results
+    bool is_skipped_token(const std::string &s)
+    {
+      return s[0] == '$' || s == "1-0" || s == "0-1" || s == "1/2-1/2" || s == "*" ||
+             (std::isdigit((unsigned char)s[0]) && s.back() == '.');
+    }
+
+    // SAN without the check suffix
+    std::string san_base(const Position &pos, Move m)
+    {
+      const Square from = m.from_sq();
+      const Square to = m.to_sq();
+
+      if (m.type_of() == CASTLING)
+        return to > from ? "O-O" : "O-O-O";
+
+      const PieceType pt = type_of(pos.moved_piece(m));
+      std::string s;
+
+      if (pt == PAWN)
+      {
+        if (pos.capture(m))
+          s += char('a' + file_of(from));
+      }
+      else
+      {
+        s += " PNBRQK"[pt];
+
+        // Other pieces of the same type that can legally reach the same square
+        Bitboard others = pos.attackers_to(to) & pos.pieces(pos.side_to_move(), pt) & ~square_bb(from);
+        Bitboard ambiguous = 0;
+        while (others)
+        {
+          const Square o = pop_lsb(others);
+          if (pos.legal(Move(o, to)))
+            ambiguous |= o;
+        }
+
+        if (ambiguous)
+        {
+          if (!(ambiguous & file_bb(from)))
+            s += char('a' + file_of(from));
+          else if (!(ambiguous & rank_bb(from)))
+            s += char('1' + rank_of(from));
+          else
+            s += UCIEngine::square(from);
+        }
+      }
+
+      if (pos.capture(m))
+        s += 'x';
+
+      s += UCIEngine::square(to);
+
+      if (m.type_of() == PROMOTION)
+      {
+        s += '=';
+        s += " PNBRQK"[m.promotion_type()];
+      }
+
+      return s;
+    }
+
+    void describe(const Position &pos, Move m, const std::string &sanBase, stockfish_ply &p)
+    {
+      std::memset(&p, 0, sizeof(p));
+
+      const MoveList<LEGAL> legal(pos);
+      for (const auto &lm : legal)
+      {
+        const uint16_t code = Events::encode(lm, pos.is_chess960());
+        p.legal[(code >> 6) & 63] |= uint64_t(1) << (code & 63);
+      }
+
+      p.key = pos.key();
+      p.move = m ? Events::encode(m, pos.is_chess960()) : 0;
+      p.legalCount = uint16_t(legal.size());
+      p.rule50 = uint16_t(pos.rule50_count());
+
+      const bool mated = pos.checkers() && !legal.size();
+
+      if (pos.checkers())
+        p.flags |= mated ? STOCKFISH_PLY_CHECK | STOCKFISH_PLY_CHECKMATE : STOCKFISH_PLY_CHECK;
+      else if (!legal.size())
+        p.flags |= STOCKFISH_PLY_STALEMATE;
+
+      if (pos.rule50_count() > 99 && !mated)
+        p.flags |= STOCKFISH_PLY_FIFTY_MOVES;
+
+      if (pos.state()->repetition)
+        p.flags |= STOCKFISH_PLY_REPETITION;
+
+      if (pos.state()->repetition < 0)
+        p.flags |= STOCKFISH_PLY_THREEFOLD;
+
+      // At ply 0 both detect only repetitions of positions before the current one
+      if (pos.upcoming_repetition(0))
+        p.flags |= STOCKFISH_PLY_UPCOMING_REPETITION;
+
+      if (m)
+      {
+        const std::string s = sanBase + (mated ? "#" : pos.checkers() ? "+" : "");
+        std::strncpy(p.san, s.c_str(), sizeof(p.san) - 1);
+      }
+    }
+
+  } // namespace
+
+  void init_tables()
+  {
+    std::call_once(initFlag, []()
+                   {
+                     Bitboards::init();
+                     Position::init();
+                   });
+  }
+
+  namespace Board
+  {
+
+    Move parse_move(Position &pos, std::string token)
+    {
+      while (!token.empty() && std::strchr("+#!?", token.back()))
+        token.pop_back();
+
+      if (is_uci_move(token))
+        return UCIEngine::to_move(pos, token);
+
+      // Accept castling written with zeros and promotions without '='
+      std::replace(token.begin(), token.end(), '0', 'O');
+      token.erase(std::remove(token.begin(), token.end(), '='), token.end());
+
+      for (const auto &m : MoveList<LEGAL>(pos))
+      {
+        std::string s = san_base(pos, m);
+        s.erase(std::remove(s.begin(), s.end(), '='), s.end());
+
+        if (s == token)
+          return m;
+      }
+
+      return Move::none();
+    }
+
+    int replay(const std::string &fen, bool chess960, const std::string &moves, stockfish_ply *out,
+               int maxPlies)
+    {
+      init_tables();
+
+      if (maxPlies <= 0)
+        return -1;
+
+      // The whole history is kept for the repetition detection
+      std::deque<StateInfo> states(1);
+      Position pos;
+      if (!pos.set_legal(fen.empty() ? StartFEN : fen, chess960, &states.back()))
+        return -1;
+
+      describe(pos, Move::none(), "", out[0]);
+
+      int n = 1;
+      std::istringstream is(moves);
+      std::string token;
+
+      while (n < maxPlies && is >> token)
+      {
+        // A move number may be glued to the move, as in "1.e4"
+        const size_t dot = token.find_last_of('.');
+        if (dot != std::string::npos && dot + 1 < token.size() && std::isdigit((unsigned char)token[0]))
+          token.erase(0, dot + 1);
+
+        if (is_skipped_token(token))
+          continue;
+
+        const Move m = parse_move(pos, token);
+        if (!m)
+        {
+          out[n - 1].flags |= STOCKFISH_PLY_REJECTED_NEXT;
+          break;
+        }
+
+        const std::string sanBase = san_base(pos, m);
+        states.emplace_back();
+        pos.do_move(m, states.back());
+        describe(pos, m, sanBase, out[n++]);
+      }
+
+      return n;
+    }
+
+  } // namespace Board
+
+} // namespace Stockfish
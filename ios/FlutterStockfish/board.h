@@ -0,0 +1,31 @@
+#ifndef FLUTTER_STOCKFISH_BOARD_H
+#define FLUTTER_STOCKFISH_BOARD_H
+
+#include <string>
+
+#include "../Stockfish/src/position.h"
+#include "../Stockfish/src/types.h"
+#include "ffi.h"
+
+namespace Stockfish
+{
+
+  // Fills the process wide lookup tables, once for all engines and callers
+  void init_tables();
+
+  namespace Board
+  {
+
+    // Reads a move in UCI notation or SAN. Returns Move::none() if it is
+    // not a legal move in pos.
+    Move parse_move(Position &pos, std::string token);
+
+    // See stockfish_board_replay() in ffi.h
+    int replay(const std::string &fen, bool chess960, const std::string &moves, stockfish_ply *out,
+               int maxPlies);
+
+  } // namespace Board
+
+} // namespace Stockfish
+
+#endif // #ifndef FLUTTER_STOCKFISH_BOARD_H
@@ -0,0 +1,242 @@
+// libstockfish.so when the engine is built once per instruction set level, in
+// libstockfish_<arch>.so (see android/CMakeLists.txt). The first call loads
+// the best build the CPU supports, or the one named by the STOCKFISH_ARCH
+// environment variable, and every function of ffi.h forwards to it. The
+// networks are embedded here only once, for all of them.
+//
+// The builds are separate libraries rather than objects of this one because
+// they share inline functions and template instances (the standard library's)
+// compiled with different instruction sets: linked together, the ones kept
+// could be those of a better level than the CPU has.
+
+#if defined(STOCKFISH_DISPATCH)
+
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <string>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#define INCBIN_SILENCE_BITCODE_WARNING
+#include "../Stockfish/src/incbin/incbin.h"
+
+#include "../Stockfish/src/evaluate.h"
+
+#include "ffi.h"
+
+INCBIN(EmbeddedNNUEBig, EvalFileDefaultNameBig);
+INCBIN(EmbeddedNNUESmall, EvalFileDefaultNameSmall);
+
+#define STOCKFISH_FFI_FUNCTIONS(F)   \
+  F(stockfish_init)                  \
+  F(stockfish_main)                  \
+  F(stockfish_stdin_write)           \
+  F(stockfish_stdout_read)           \
+  F(stockfish_engine_create)         \
+  F(stockfish_engine_destroy)        \
+  F(stockfish_engine_command)        \
+  F(stockfish_engine_poll)           \
+  F(stockfish_engine_events_open)    \
+  F(stockfish_engine_events_read)    \
+  F(stockfish_engine_events_dropped) \
+  F(stockfish_engine_evaluate)       \
+  F(stockfish_engine_save_hash)      \
+  F(stockfish_engine_load_hash)      \
+  F(stockfish_engine_tt_stats)       \
+  F(stockfish_engine_ponder_stats)   \
+  F(stockfish_engine_startup_stats)  \
+  F(stockfish_board_replay)
+
+namespace
+{
+
+  struct Functions
+  {
+#define STOCKFISH_FFI_POINTER(name) decltype(&::name) name = nullptr;
+    STOCKFISH_FFI_FUNCTIONS(STOCKFISH_FFI_POINTER)
+#undef STOCKFISH_FFI_POINTER
+  };
+
+  struct Arch
+  {
+    const char *name;
+    bool (*supported)();
+  };
+
+  // Best first, the last one runs on every CPU of the ABI
+#if defined(__aarch64__) && defined(__linux__)
+  const Arch Archs[] = {
+      {"armv8-dotprod", [] { return (getauxval(AT_HWCAP) & HWCAP_ASIMDDP) != 0; }},
+      {"armv8", [] { return true; }},
+  };
+#elif defined(__x86_64__)
+  const Arch Archs[] = {
+      {"x86-64-vnni512", [] {
+         return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+             && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")
+             && __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("bmi2");
+       }},
+      {"x86-64-avx2", [] { return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi"); }},
+      {"x86-64-sse41-popcnt", [] { return true; }},
+  };
+#else
+#error "No instruction set levels for this architecture, build a single library instead"
+#endif
+
+  // Looks for the library by name in the paths of the application, then next
+  // to this one
+  void *open_arch(const std::string &arch)
+  {
+    const std::string file = "libstockfish_" + arch + ".so";
+
+    if (void *lib = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL))
+      return lib;
+
+    Dl_info info;
+    if (!dladdr(reinterpret_cast<void *>(&open_arch), &info) || !info.dli_fname)
+      return nullptr;
+
+    std::string path = info.dli_fname;
+    path = path.substr(0, path.find_last_of('/') + 1) + file;
+    return dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  }
+
+  bool load(const std::string &arch, Functions &functions)
+  {
+    void *lib = open_arch(arch);
+    if (!lib)
+      return false;
+
+    bool complete = true;
+
+#define STOCKFISH_FFI_SYMBOL(name)                                                  \
+  functions.name = reinterpret_cast<decltype(functions.name)>(dlsym(lib, #name)); \
+  complete &= functions.name != nullptr;
+    STOCKFISH_FFI_FUNCTIONS(STOCKFISH_FFI_SYMBOL)
+#undef STOCKFISH_FFI_SYMBOL
+
+    if (!complete)
+      dlclose(lib);
+
+    return complete;
+  }
+
+  Functions select()
+  {
+    Functions functions;
+
+    if (const char *forced = std::getenv("STOCKFISH_ARCH"))
+      if (load(forced, functions))
+        return functions;
+
+    for (const Arch &arch : Archs)
+      if (arch.supported() && load(arch.name, functions))
+        return functions;
+
+    std::fprintf(stderr, "stockfish: no libstockfish_<arch>.so could be loaded\n");
+    std::abort();
+  }
+
+  const Functions &functions()
+  {
+    static const Functions f = select();
+    return f;
+  }
+
+} // namespace
+
+int stockfish_init()
+{
+  return functions().stockfish_init();
+}
+
+int stockfish_main()
+{
+  return functions().stockfish_main();
+}
+
+ssize_t stockfish_stdin_write(char *data)
+{
+  return functions().stockfish_stdin_write(data);
+}
+
+char *stockfish_stdout_read()
+{
+  return functions().stockfish_stdout_read();
+}
+
+void *stockfish_engine_create()
+{
+  return functions().stockfish_engine_create();
+}
+
+void stockfish_engine_destroy(void *handle)
+{
+  functions().stockfish_engine_destroy(handle);
+}
+
+int stockfish_engine_command(void *handle, const char *command)
+{
+  return functions().stockfish_engine_command(handle, command);
+}
+
+const char *stockfish_engine_poll(void *handle, int timeoutMs)
+{
+  return functions().stockfish_engine_poll(handle, timeoutMs);
+}
+
+int stockfish_engine_events_open(void *handle, int capacity)
+{
+  return functions().stockfish_engine_events_open(handle, capacity);
+}
+
+int stockfish_engine_events_read(void *handle, stockfish_event *out, int maxCount)
+{
+  return functions().stockfish_engine_events_read(handle, out, maxCount);
+}
+
+int64_t stockfish_engine_events_dropped(void *handle)
+{
+  return functions().stockfish_engine_events_dropped(handle);
+}
+
+int stockfish_engine_evaluate(void *handle, const char *const *fens, int count, stockfish_eval *out)
+{
+  return functions().stockfish_engine_evaluate(handle, fens, count, out);
+}
+
+int stockfish_engine_save_hash(void *handle, const char *path, int maxAge)
+{
+  return functions().stockfish_engine_save_hash(handle, path, maxAge);
+}
+
+int stockfish_engine_load_hash(void *handle, const char *path)
+{
+  return functions().stockfish_engine_load_hash(handle, path);
+}
+
+int stockfish_engine_tt_stats(void *handle, int reset, stockfish_tt_stats *out)
+{
+  return functions().stockfish_engine_tt_stats(handle, reset, out);
+}
+
+int stockfish_engine_ponder_stats(void *handle, int reset, stockfish_ponder_stats *out)
+{
+  return functions().stockfish_engine_ponder_stats(handle, reset, out);
+}
+
+int stockfish_engine_startup_stats(void *handle, stockfish_startup_stats *out)
+{
+  return functions().stockfish_engine_startup_stats(handle, out);
+}
+
+int stockfish_board_replay(const char *fen, int chess960, const char *moves, stockfish_ply *out, int maxPlies)
+{
+  return functions().stockfish_board_replay(fen, chess960, moves, out, maxPlies);
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include "events.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../Stockfish/src/score.h"
+
+namespace Stockfish::Events
+{
+
+  namespace
+  {
+
+    void set_score(stockfish_event &e, const Score &s)
+    {
+      if (s.is<Score::Mate>())
+      {
+        const int plies = s.get<Score::Mate>().plies;
+        e.scoreType = STOCKFISH_SCORE_MATE;
+        e.score = (plies > 0 ? plies + 1 : plies) / 2;
+      }
+      else if (s.is<Score::Tablebase>())
+      {
+        e.scoreType = STOCKFISH_SCORE_TB;
+        e.score = s.get<Score::Tablebase>().plies;
+      }
+      else
+      {
+        e.scoreType = STOCKFISH_SCORE_CP;
+        e.score = s.get<Score::InternalUnits>().value;
+      }
+    }
+
+    void clear(stockfish_event &e, uint8_t type)
+    {
+      // Only the header is reset, the pv is valid up to pvLength
+      std::memset(&e, 0, offsetof(stockfish_event, pv));
+      e.type = type;
+    }
+
+  } // namespace
+
+  uint16_t encode(Move m, bool chess960)
+  {
+    if (!m.is_ok())
+      return 0;
+
+    Square from = m.from_sq();
+    Square to = m.to_sq();
+
+    if (m.type_of() == CASTLING && !chess960)
+      to = make_square(to > from ? FILE_G : FILE_C, rank_of(from));
+
+    uint16_t code = uint16_t(int(to) | (int(from) << 6));
+
+    if (m.type_of() == PROMOTION)
+      code |= uint16_t(m.promotion_type() << 12);
+
+    return code;
+  }
+
+  uint16_t encode(std::string_view uciMove)
+  {
+    if (uciMove.size() < 4 || uciMove[0] < 'a' || uciMove[0] > 'h')
+      return 0;
+
+    auto square = [&](size_t i)
+    { return (uciMove[i] - 'a') | ((uciMove[i + 1] - '1') << 3); };
+
+    uint16_t code = uint16_t(square(2) | (square(0) << 6));
+
+    if (uciMove.size() > 4)
+    {
+      const auto pt = std::string_view(" pnbrqk").find(uciMove[4]);
+      if (pt != std::string_view::npos)
+        code |= uint16_t(pt << 12);
+    }
+
+    return code;
+  }
+
+  void fill(stockfish_event &e, const Engine::InfoShort &info)
+  {
+    clear(e, STOCKFISH_EVENT_NO_MOVES);
+    e.depth = info.depth;
+    set_score(e, info.score);
+  }
+
+  void fill(stockfish_event &e, const Engine::InfoFull &info, bool chess960)
+  {
+    clear(e, STOCKFISH_EVENT_INFO);
+    e.depth = info.depth;
+    e.selDepth = info.selDepth;
+    e.multiPV = uint32_t(info.multiPV);
+    e.hashfull = info.hashfull;
+    e.bound = info.bound == "lowerbound"   ? STOCKFISH_BOUND_LOWER
+              : info.bound == "upperbound" ? STOCKFISH_BOUND_UPPER
+                                           : STOCKFISH_BOUND_EXACT;
+    set_score(e, info.score);
+
+    for (int i = 0; i < 3; ++i)
+      e.wdl[i] = uint16_t(info.wdlPerMille[i]);
+
+    e.nodes = info.nodes;
+    e.nps = info.nps;
+    e.tbHits = info.tbHits;
+    e.timeMs = info.timeMs;
+
+    e.pvLength = uint16_t(std::min(info.pvLength, size_t(STOCKFISH_EVENT_MAX_PV)));
+    for (size_t i = 0; i < e.pvLength; ++i)
+      e.pv[i] = encode(info.pvMoves[i], chess960);
+  }
+
+  void fill(stockfish_event &e, const Engine::InfoIter &info)
+  {
+    clear(e, STOCKFISH_EVENT_CURRMOVE);
+    e.depth = info.depth;
+    e.multiPV = uint32_t(info.currmovenumber);
+    e.pvLength = 1;
+    e.pv[0] = encode(info.currmove);
+  }
+
+  void fill(stockfish_event &e, std::string_view bestmove, std::string_view ponder)
+  {
+    clear(e, STOCKFISH_EVENT_BESTMOVE);
+    e.pv[0] = encode(bestmove);
+    e.pv[1] = encode(ponder);
+    e.pvLength = ponder.empty() ? 1 : 2;
+  }
+
+} // namespace Stockfish::Events
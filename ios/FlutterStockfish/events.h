@@ -0,0 +1,25 @@
+#ifndef FLUTTER_STOCKFISH_EVENTS_H
+#define FLUTTER_STOCKFISH_EVENTS_H
+
+#include <cstdint>
+#include <string_view>
+
+#include "../Stockfish/src/engine.h"
+#include "../Stockfish/src/types.h"
+#include "ffi.h"
+
+namespace Stockfish::Events
+{
+
+  // Encodes a move in the 16-bit layout documented in ffi.h
+  uint16_t encode(Move m, bool chess960);
+  uint16_t encode(std::string_view uciMove);
+
+  void fill(stockfish_event &e, const Engine::InfoShort &info);
+  void fill(stockfish_event &e, const Engine::InfoFull &info, bool chess960);
+  void fill(stockfish_event &e, const Engine::InfoIter &info);
+  void fill(stockfish_event &e, std::string_view bestmove, std::string_view ponder);
+
+} // namespace Stockfish::Events
+
+#endif // #ifndef FLUTTER_STOCKFISH_EVENTS_H
@@ -1,6 +1,8 @@
+#include <cstring>
 #include <iostream>
 #include <stdio.h>
 #include <unistd.h>
+#include <vector>
 
 #include "../Stockfish/src/bitboard.h"
 #include "../Stockfish/src/misc.h"
@@ -9,7 +11,10 @@
 #include "../Stockfish/src/uci.h"
 #include "../Stockfish/src/tune.h"
 
+#include "board.h"
 #include "ffi.h"
+#include "instance.h"
+#include "line_ring.h"
 
 // https://jineshkj.wordpress.com/2006/12/22/how-to-capture-stdin-stdout-and-stderr-of-child-program/
 #define NUM_PIPES 2
@@ -17,21 +22,26 @@
 #define PARENT_READ_PIPE 1
 #define READ_FD 0
 #define WRITE_FD 1
-#define PARENT_READ_FD (pipes[PARENT_READ_PIPE][READ_FD])
 #define PARENT_WRITE_FD (pipes[PARENT_WRITE_PIPE][WRITE_FD])
 #define CHILD_READ_FD (pipes[PARENT_WRITE_PIPE][READ_FD])
-#define CHILD_WRITE_FD (pipes[PARENT_READ_PIPE][WRITE_FD])
 
 int main(int, char **);
 
 const char *QUITOK = "quitok\n";
 int pipes[NUM_PIPES][2];
-char buffer[80];
+
+// The engine output does not go through a pipe but through a shared memory
+// ring installed as the std::cout buffer, so that one read returns all the
+// complete lines written since the previous one.
+Stockfish::LineRing outputRing(1 << 20);
+Stockfish::LineRingStreambuf outputBuf(outputRing);
+std::vector<char> outputLines;
+bool outputQuit = false;
 
 int stockfish_init()
 {
-  pipe(pipes[PARENT_READ_PIPE]);
   pipe(pipes[PARENT_WRITE_PIPE]);
+  outputQuit = false;
 
   return 0;
 }
@@ -39,13 +49,14 @@ int stockfish_init()
 int stockfish_main()
 {
   dup2(CHILD_READ_FD, STDIN_FILENO);
-  dup2(CHILD_WRITE_FD, STDOUT_FILENO);
+  std::streambuf *stdoutBuf = std::cout.rdbuf(&outputBuf);
 
   int argc = 1;
   char *argv[] = {""};
   int exitCode = main(argc, argv);
 
   std::cout << QUITOK << std::flush;
+  std::cout.rdbuf(stdoutBuf);
 
   return exitCode;
 }
@@ -57,17 +68,254 @@ ssize_t stockfish_stdin_write(char *data)
 
 char *stockfish_stdout_read()
 {
-  ssize_t count = read(PARENT_READ_FD, buffer, sizeof(buffer) - 1);
-  if (count < 0)
+  if (outputQuit)
   {
     return NULL;
   }
 
-  buffer[count] = 0;
-  if (strcmp(buffer, QUITOK) == 0)
+  outputLines.clear();
+  outputRing.drain(outputLines);
+
+  const size_t quitLength = strlen(QUITOK);
+  const size_t size = outputLines.size();
+  // The engine writes nothing after QUITOK, so it can only end a batch
+  if (size >= quitLength &&
+      memcmp(&outputLines[size - quitLength], QUITOK, quitLength) == 0 &&
+      (size == quitLength || outputLines[size - quitLength - 1] == '\n'))
+  {
+    outputQuit = true;
+    outputLines.resize(size - quitLength);
+
+    if (outputLines.empty())
+    {
+      return NULL;
+    }
+  }
+
+  outputLines.push_back(0);
+  return outputLines.data();
+}
+
+void *stockfish_engine_create()
+{
+  return new Stockfish::Instance();
+}
+
+void stockfish_engine_destroy(void *handle)
+{
+  delete static_cast<Stockfish::Instance *>(handle);
+}
+
+// Returns 0 when the command was accepted, 1 once the engine has been told
+// to quit (the handle must still be destroyed) and -1 on invalid arguments.
+int stockfish_engine_command(void *handle, const char *command)
+{
+  if (handle == NULL || command == NULL)
+  {
+    return -1;
+  }
+
+  return static_cast<Stockfish::Instance *>(handle)->command(command) ? 0 : 1;
+}
+
+const char *stockfish_engine_poll(void *handle, int timeoutMs)
+{
+  if (handle == NULL)
   {
     return NULL;
   }
 
-  return buffer;
+  return static_cast<Stockfish::Instance *>(handle)->poll(timeoutMs);
+}
+
+int stockfish_engine_events_open(void *handle, int capacity)
+{
+  if (handle == NULL || capacity <= 0)
+  {
+    return -1;
+  }
+
+  static_cast<Stockfish::Instance *>(handle)->open_events(size_t(capacity));
+  return 0;
+}
+
+int stockfish_engine_events_read(void *handle, stockfish_event *out, int maxCount)
+{
+  if (handle == NULL || out == NULL || maxCount < 0)
+  {
+    return -1;
+  }
+
+  return static_cast<Stockfish::Instance *>(handle)->read_events(out, size_t(maxCount));
+}
+
+int64_t stockfish_engine_events_dropped(void *handle)
+{
+  if (handle == NULL)
+  {
+    return -1;
+  }
+
+  return int64_t(static_cast<Stockfish::Instance *>(handle)->dropped_events());
+}
+
+int stockfish_engine_evaluate(void *handle, const char *const *fens, int count, stockfish_eval *out)
+{
+  if (handle == NULL || fens == NULL || out == NULL || count < 0)
+  {
+    return -1;
+  }
+
+  std::vector<std::string> batch;
+  batch.reserve(size_t(count));
+  for (int i = 0; i < count; ++i)
+  {
+    batch.emplace_back(fens[i] ? fens[i] : "");
+  }
+
+  const auto results = static_cast<Stockfish::Instance *>(handle)->engine().evaluate_positions(batch);
+
+  for (int i = 0; i < count; ++i)
+  {
+    out[i] = stockfish_eval{};
+
+    if (!results)
+    {
+      out[i].status = STOCKFISH_EVAL_NO_NETWORK;
+      continue;
+    }
+
+    const auto &r = (*results)[size_t(i)];
+    out[i].status = r.valid ? STOCKFISH_EVAL_OK : STOCKFISH_EVAL_NONE;
+    out[i].net = r.smallNet ? STOCKFISH_NET_SMALL : STOCKFISH_NET_BIG;
+    out[i].value = r.valid ? int32_t(r.value) : 0;
+    out[i].cp = r.valid ? int32_t(r.cp) : 0;
+  }
+
+  return 0;
+}
+
+int stockfish_engine_save_hash(void *handle, const char *path, int maxAge)
+{
+  if (handle == NULL || path == NULL)
+  {
+    return -1;
+  }
+
+  const bool saved = static_cast<Stockfish::Instance *>(handle)->engine().save_hash(path, maxAge);
+  return saved ? STOCKFISH_HASH_OK : STOCKFISH_HASH_CANNOT_OPEN;
+}
+
+int stockfish_engine_load_hash(void *handle, const char *path)
+{
+  if (handle == NULL || path == NULL)
+  {
+    return -1;
+  }
+
+  static_assert(int(Stockfish::TTFileStatus::Ok) == STOCKFISH_HASH_OK &&
+                    int(Stockfish::TTFileStatus::CannotOpen) == STOCKFISH_HASH_CANNOT_OPEN &&
+                    int(Stockfish::TTFileStatus::BadFormat) == STOCKFISH_HASH_BAD_FORMAT &&
+                    int(Stockfish::TTFileStatus::WrongLayout) == STOCKFISH_HASH_WRONG_LAYOUT &&
+                    int(Stockfish::TTFileStatus::WrongNetworks) == STOCKFISH_HASH_WRONG_NETWORKS &&
+                    int(Stockfish::TTFileStatus::Truncated) == STOCKFISH_HASH_TRUNCATED &&
+                    int(Stockfish::TTFileStatus::WrongSize) == STOCKFISH_HASH_WRONG_SIZE,
+                "STOCKFISH_HASH_* codes must follow TTFileStatus");
+
+  return int(static_cast<Stockfish::Instance *>(handle)->engine().load_hash(path));
+}
+
+int stockfish_engine_tt_stats(void *handle, int reset, stockfish_tt_stats *out)
+{
+  if (handle == NULL || out == NULL)
+  {
+    return -1;
+  }
+
+  using Stockfish::TTCounters;
+  using Stockfish::TTStats;
+
+  static_assert(TTStats::DepthBuckets == STOCKFISH_TT_DEPTH_BUCKETS &&
+                    TTStats::AgeBuckets == STOCKFISH_TT_AGE_BUCKETS,
+                "stockfish_tt_stats histograms must follow TTStats");
+
+  const TTStats s = static_cast<Stockfish::Instance *>(handle)->engine().get_tt_stats(reset != 0);
+
+  std::memset(out, 0, sizeof(*out));
+  out->probes = s.counters[TTCounters::Probes];
+  out->hits = s.counters[TTCounters::Hits];
+  out->cacheHits = s.counters[TTCounters::CacheHits];
+  out->falseHits = uint64_t(s.falseHits + 0.5);
+  out->remoteProbes = s.counters[TTCounters::RemoteProbes];
+  out->writes = s.counters[TTCounters::Writes];
+  out->filled = s.counters[TTCounters::Filled];
+  out->replacedOlder = s.counters[TTCounters::ReplacedOlder];
+  out->replacedShallower = s.counters[TTCounters::ReplacedShallower];
+  out->updatedExact = s.counters[TTCounters::UpdatedExact];
+  out->updatedDeeper = s.counters[TTCounters::UpdatedDeeper];
+  out->updatedOlder = s.counters[TTCounters::UpdatedOlder];
+  out->kept = s.counters[TTCounters::Kept];
+  out->entries = s.entries;
+  out->occupied = s.occupied;
+  std::memcpy(out->depth, s.depth, sizeof(out->depth));
+  std::memcpy(out->age, s.age, sizeof(out->age));
+  out->countersEnabled = s.countersEnabled;
+  out->numaNodes = uint32_t(s.numaNodes);
+  return 0;
+}
+
+int stockfish_engine_ponder_stats(void *handle, int reset, stockfish_ponder_stats *out)
+{
+  if (handle == NULL || out == NULL)
+  {
+    return -1;
+  }
+
+  const Stockfish::Search::PonderStats s =
+      static_cast<Stockfish::Instance *>(handle)->engine().get_ponder_stats(reset != 0);
+
+  out->speculations = s.speculations;
+  out->hits = s.hits;
+  out->alternateHits = s.alternateHits;
+  out->misses = s.misses;
+  out->hitTimeMs = s.hitTime;
+  out->ponderedMs = s.pondered;
+  out->depthTaken = s.depthTaken;
+  out->backgroundSearches = s.backgroundSearches;
+  out->backgroundNodes = s.backgroundNodes;
+  out->backgroundBusyMs = s.backgroundBusy;
+  out->backgroundTimeMs = s.backgroundTime;
+  out->backgroundHashfull = s.backgroundHashfull;
+  out->preemptions = s.preemptions;
+  out->preemptTimeUs = s.preemptTime;
+  out->preemptMaxUs = s.preemptMax;
+  return 0;
+}
+
+int stockfish_engine_startup_stats(void *handle, stockfish_startup_stats *out)
+{
+  if (handle == NULL || out == NULL)
+  {
+    return -1;
+  }
+
+  const Stockfish::Engine::StartupStats s =
+      static_cast<Stockfish::Instance *>(handle)->engine().get_startup_stats();
+
+  out->createdUs = s.created;
+  out->networkLoads = s.networkLoads;
+  out->networkReadUs = s.networkRead;
+  out->networkShareUs = s.networkShare;
+  out->threadsResetUs = s.threadsReset;
+  return 0;
+}
+
+int stockfish_board_replay(const char *fen, int chess960, const char *moves, stockfish_ply *out, int maxPlies)
+{
+  if (out == NULL || maxPlies <= 0)
+  {
+    return -1;
+  }
+
+  return Stockfish::Board::replay(fen ? fen : "", chess960 != 0, moves ? moves : "", out, maxPlies);
 }
@@ -1,3 +1,9 @@
+#ifndef FLUTTER_STOCKFISH_FFI_H
+#define FLUTTER_STOCKFISH_FFI_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
 #ifdef __cplusplus
 extern "C" __attribute__((visibility("default"))) __attribute__((used))
 #endif
@@ -21,3 +27,286 @@ extern "C" __attribute__((visibility("default"))) __attribute__((used))
 #endif
 char *
 stockfish_stdout_read();
+
+// Handle based API. Each handle is an independent engine with its own
+// threads, hash and options; any number of them can be alive at once.
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+void *
+stockfish_engine_create();
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+void
+stockfish_engine_destroy(void *handle);
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+stockfish_engine_command(void *handle, const char *command);
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+const char *
+stockfish_engine_poll(void *handle, int timeoutMs);
+
+// Structured search events. Once a handle's event stream is opened, the
+// search updates are no longer rendered as 'info'/'bestmove' text but are
+// written as fixed layout records into a preallocated ring.
+//
+// Moves are 16-bit codes: bits 0-5 the destination square, bits 6-11 the
+// origin square (a1 = 0, h8 = 63) and bits 12-14 the promotion piece type
+// (0 none, 2 knight, 3 bishop, 4 rook, 5 queen). Castling is encoded as the
+// king move of the UCI notation in use, so e1g1 in standard chess.
+
+#define STOCKFISH_EVENT_MAX_PV 256
+
+#define STOCKFISH_EVENT_INFO 1     // One 'info ... pv' line
+#define STOCKFISH_EVENT_CURRMOVE 2 // pv[0] is currmove, multiPV is currmovenumber
+#define STOCKFISH_EVENT_NO_MOVES 3 // Root is mate or stalemate
+#define STOCKFISH_EVENT_BESTMOVE 4 // pv[0] is bestmove, pv[1] the ponder move if pvLength is 2
+
+#define STOCKFISH_SCORE_CP 0   // score in centipawns
+#define STOCKFISH_SCORE_MATE 1 // score in moves, negative when getting mated
+#define STOCKFISH_SCORE_TB 2   // score in plies to a tablebase win, negative for a loss
+
+#define STOCKFISH_BOUND_EXACT 0
+#define STOCKFISH_BOUND_LOWER 1
+#define STOCKFISH_BOUND_UPPER 2
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t scoreType;
+  uint8_t bound;
+  uint8_t reserved;
+  int32_t score;
+  int32_t depth;
+  int32_t selDepth;
+  uint32_t multiPV;
+  int32_t hashfull;
+  uint16_t wdl[3];
+  uint16_t pvLength;
+  uint64_t nodes;
+  uint64_t nps;
+  uint64_t tbHits;
+  uint64_t timeMs;
+  uint16_t pv[STOCKFISH_EVENT_MAX_PV];
+} stockfish_event;
+
+// Switches the handle to structured events, with room for at least
+// capacity records. Returns 0 on success.
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+stockfish_engine_events_open(void *handle, int capacity);
+
+// Copies up to maxCount pending events to out and returns how many were
+// copied, or -1 if the stream is not open.
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+stockfish_engine_events_read(void *handle, stockfish_event *out, int maxCount);
+
+// Number of events dropped so far because the ring was full
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int64_t
+stockfish_engine_events_dropped(void *handle);
+
+// Synchronous static evaluation, without going through UCI commands. The
+// scores are from the point of view of the side to move: value in internal
+// units as returned by Eval::evaluate(), cp normalized like 'score cp'.
+
+#define STOCKFISH_EVAL_OK 0         // the position was evaluated
+#define STOCKFISH_EVAL_NONE 1       // illegal or in check, value and cp are unset
+#define STOCKFISH_EVAL_NO_NETWORK 2 // the networks set by the options are not loaded
+
+#define STOCKFISH_NET_BIG 0
+#define STOCKFISH_NET_SMALL 1
+
+typedef struct
+{
+  int32_t value;
+  int32_t cp;
+  uint8_t status;
+  uint8_t net; // the net that produced the final score
+  uint8_t reserved[2];
+} stockfish_eval;
+
+// Evaluates count FENs into out[0..count). Runs on the calling thread and
+// may overlap a search of the same handle. Returns 0, or -1 on bad arguments.
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+stockfish_engine_evaluate(void *handle, const char *const *fens, int count, stockfish_eval *out);
+
+// Transposition table persistence. Both calls wait for a running search of
+// the handle to finish. A file is only loaded into a table of the Hash size it
+// was saved with; one of another size is rejected with STOCKFISH_HASH_WRONG_SIZE
+// and the table is left untouched.
+
+#define STOCKFISH_HASH_OK 0
+#define STOCKFISH_HASH_CANNOT_OPEN 1
+#define STOCKFISH_HASH_BAD_FORMAT 2     // not a saved table, or of another format version
+#define STOCKFISH_HASH_WRONG_LAYOUT 3   // saved by a build with another entry layout
+#define STOCKFISH_HASH_WRONG_NETWORKS 4 // saved while other networks were loaded
+#define STOCKFISH_HASH_TRUNCATED 5
+#define STOCKFISH_HASH_WRONG_SIZE 6     // saved with another Hash size
+
+// Saves the entries written during the last maxAge + 1 searches, or all of
+// them if maxAge is negative. Returns STOCKFISH_HASH_OK or
+// STOCKFISH_HASH_CANNOT_OPEN, or -1 on bad arguments.
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+stockfish_engine_save_hash(void *handle, const char *path, int maxAge);
+
+// Returns one of the STOCKFISH_HASH_* codes, or -1 on bad arguments. On
+// failure the table is left as it was, unless it is STOCKFISH_HASH_TRUNCATED.
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+stockfish_engine_load_hash(void *handle, const char *path);
+
+// Transposition table statistics, as shown by the 'ttstats' command. The
+// histograms cover the part of the table searched last. The probe and write
+// counters are those of all the search threads; they are zero and
+// countersEnabled is 0 unless the library was built with TT_STATS or without
+// NDEBUG, as counting slows the search down.
+
+#define STOCKFISH_TT_DEPTH_BUCKETS 32
+#define STOCKFISH_TT_AGE_BUCKETS 32
+
+typedef struct
+{
+  uint64_t probes;
+  uint64_t hits;
+  uint64_t cacheHits;         // of the hits, those found in a thread cache (ThreadHashCache)
+  uint64_t falseHits;         // estimated key collisions among the hits
+  uint64_t remoteProbes;      // of the other probes, clusters read on another NUMA node
+  uint64_t writes;            // of which:
+  uint64_t filled;            // to an empty entry
+  uint64_t replacedOlder;     // over another position, written in an older search
+  uint64_t replacedShallower; // over another position, of the current search
+  uint64_t updatedExact;      // of the same position, with an exact bound
+  uint64_t updatedDeeper;     // of the same position, searched deeper
+  uint64_t updatedOlder;      // of the same position, written in an older search
+  uint64_t kept;              // left out, the entry being worth more
+  uint64_t entries;
+  uint64_t occupied;
+  uint64_t depth[STOCKFISH_TT_DEPTH_BUCKETS]; // depth[0] counts qsearch, the last one all deeper
+  uint64_t age[STOCKFISH_TT_AGE_BUCKETS];     // searches since the entry was written
+  uint8_t countersEnabled;
+  uint8_t reserved[3];
+  uint32_t numaNodes; // the pages are placed on (HashPlacement), 0 if left to the system
+} stockfish_tt_stats;
+
+// Fills out, then resets the counters if reset is not 0. May be called during
+// a search. Returns 0, or -1 on bad arguments.
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+stockfish_engine_tt_stats(void *handle, int reset, stockfish_tt_stats *out);
+
+// Outcome of the ponder searches split over several replies of the opponent
+// (PonderCandidates) and of the searches kept running after bestmove
+// (BackgroundSearch), as shown by the 'ponderstats' command. Times add up
+// those of the search threads.
+
+typedef struct
+{
+  uint64_t speculations;  // ponder searches split over several replies
+  uint64_t hits;          // the expected reply was played
+  uint64_t alternateHits; // another reply searched was played, and taken over
+  uint64_t misses;        // none of the replies searched was played
+  uint64_t hitTimeMs;     // spent on the replies played
+  uint64_t ponderedMs;    // spent pondering in all
+  uint64_t depthTaken;    // iterations skipped by taking the replies played over
+
+  uint64_t backgroundSearches; // searches kept running after bestmove
+  uint64_t backgroundNodes;
+  uint64_t backgroundBusyMs;   // the threads were searching
+  uint64_t backgroundTimeMs;   // from bestmove to the next command
+  uint64_t backgroundHashfull; // permille of the hash written, summed over the searches
+  uint64_t preemptions;        // background searches stopped by a command
+  uint64_t preemptTimeUs;      // taken to stop them
+  uint64_t preemptMaxUs;
+} stockfish_ponder_stats;
+
+// Fills out, then resets the counters if reset is not 0. Must not be called
+// during a search. Returns 0, or -1 on bad arguments.
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+stockfish_engine_ponder_stats(void *handle, int reset, stockfish_ponder_stats *out);
+
+// Time spent creating the engine and loading the networks, in microseconds, as
+// shown by the 'startupstats' command
+
+typedef struct
+{
+  uint64_t createdUs;      // stockfish_engine_create(), the first load included
+  uint64_t networkLoads;   // of both networks at creation, then of either
+  uint64_t networkReadUs;  // reading and decoding the files
+  uint64_t networkShareUs; // copying, identifying and replicating them
+  uint64_t threadsResetUs; // clearing the threads and their network replicas
+} stockfish_startup_stats;
+
+// Fills out. Returns 0, or -1 on bad arguments.
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+stockfish_engine_startup_stats(void *handle, stockfish_startup_stats *out);
+
+// Board logic, without an engine handle. A game is replayed from a FEN and
+// described ply by ply, out[0] being the starting position and out[i] the
+// position after the i-th move. Moves use the 16-bit codes of the events.
+
+#define STOCKFISH_PLY_CHECK 0x01
+#define STOCKFISH_PLY_CHECKMATE 0x02
+#define STOCKFISH_PLY_STALEMATE 0x04
+#define STOCKFISH_PLY_FIFTY_MOVES 0x08         // 50-move rule reached and not checkmate
+#define STOCKFISH_PLY_REPETITION 0x10          // the position occurred before
+#define STOCKFISH_PLY_THREEFOLD 0x20           // ... and at least twice before
+#define STOCKFISH_PLY_UPCOMING_REPETITION 0x40 // a legal move reaches a threefold repetition
+#define STOCKFISH_PLY_REJECTED_NEXT 0x80       // the next move was illegal or unreadable
+
+typedef struct
+{
+  uint64_t key;        // Zobrist key
+  uint64_t legal[64];  // legal[from] has the destination bit of every legal move from there
+  uint16_t move;       // the move that led to this position, 0 for out[0]
+  uint16_t legalCount; // number of legal moves, each promotion piece counting once
+  uint16_t rule50;
+  uint8_t flags;
+  uint8_t reserved;
+  char san[8]; // move in SAN, NUL terminated
+} stockfish_ply;
+
+// Replays moves, a space separated list in SAN or UCI notation, from fen
+// (NULL for the start position). Move numbers, NAGs and a game result are
+// skipped, comments and variations are not supported. Writes at most
+// maxPlies records and returns how many were written, stopping at the
+// first illegal move, or -1 if the arguments or the FEN are not valid.
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+stockfish_board_replay(const char *fen, int chess960, const char *moves, stockfish_ply *out, int maxPlies);
+
+#endif // #ifndef FLUTTER_STOCKFISH_FFI_H
@@ -0,0 +1,292 @@
+#include "instance.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "../Stockfish/src/misc.h"
+#include "../Stockfish/src/position.h"
+#include "../Stockfish/src/uci.h"
+#include "board.h"
+#include "events.h"
+
+namespace Stockfish
+{
+
+  // The tables must be ready before the Engine sets up its start position
+  Instance::Instance() : eng((init_tables(), std::nullopt))
+  {
+    eng.get_options().add_info_listener([this](const std::optional<std::string> &str)
+                                        {
+                                          if (str.has_value())
+                                            emit_info_string(*str);
+                                        });
+
+    init_search_update_listeners();
+  }
+
+  Instance::~Instance()
+  {
+    scheduler.reset();
+    eng.stop();
+    eng.wait_for_search_finished();
+  }
+
+  // The single set of listeners of the engine. An update goes to the running
+  // session job if there is one, then to the event ring once it is open, and
+  // otherwise to the output as a text line.
+  void Instance::init_search_update_listeners()
+  {
+    eng.set_on_iter([this](const auto &i)
+                    {
+                      if (scheduler && scheduler->on_iter(i))
+                        return;
+                      if (events)
+                        push_event(i);
+                      else
+                        emit(UCIEngine::info_iter(i)); });
+    eng.set_on_update_no_moves([this](const auto &i)
+                               {
+                                 if (scheduler && scheduler->on_update_no_moves(i))
+                                   return;
+                                 if (events)
+                                   push_event(i);
+                                 else
+                                   emit(UCIEngine::info_no_moves(i)); });
+    eng.set_on_update_full([this](const auto &i)
+                           {
+                             if (scheduler && scheduler->on_update_full(i))
+                               return;
+                             if (events)
+                               push_event(i, bool(eng.get_options()["UCI_Chess960"]));
+                             else
+                               emit(UCIEngine::info_full(i, eng.get_options()["UCI_ShowWDL"])); });
+    eng.set_on_bestmove([this](const auto &bm, const auto &p)
+                        {
+                          if (scheduler && scheduler->on_bestmove(bm, p))
+                            return;
+                          if (events)
+                            push_event(bm, p);
+                          else
+                            emit(UCIEngine::bestmove(bm, p)); });
+    eng.set_on_verify_networks([this](const auto &s)
+                               { emit_info_string(s); });
+  }
+
+  // Only the main search thread reports updates, so it is the single producer.
+  // Sessions report text lines, so the PV stays formatted while they exist.
+  void Instance::open_events(size_t capacity)
+  {
+    if (!scheduler)
+    {
+      eng.wait_for_search_finished();
+      eng.set_info_formatting(false);
+    }
+
+    // While a scheduler exists every search is a session job, whose updates
+    // never reach the ring, so it can be replaced during one.
+    events = std::make_unique<SpscRing<stockfish_event>>(capacity);
+  }
+
+  template <typename... Args>
+  void Instance::push_event(const Args &...args)
+  {
+    if (stockfish_event *e = events->claim())
+    {
+      Events::fill(*e, args...);
+      events->commit();
+    }
+  }
+
+  int Instance::read_events(stockfish_event *out, size_t maxCount)
+  {
+    if (!events)
+      return -1;
+
+    return int(events->drain(out, maxCount));
+  }
+
+  void Instance::emit(std::string line)
+  {
+    {
+      std::lock_guard<std::mutex> lk(mutex);
+      output.push_back(std::move(line));
+    }
+    cv.notify_one();
+  }
+
+  void Instance::emit_info_string(std::string_view str)
+  {
+    for (auto &line : split(str, "\n"))
+      if (!is_whitespace(line))
+        emit("info string " + std::string(line));
+  }
+
+  const char *Instance::poll(int timeoutMs)
+  {
+    std::unique_lock<std::mutex> lk(mutex);
+    if (!cv.wait_for(lk, std::chrono::milliseconds(timeoutMs), [&]
+                     { return !output.empty(); }))
+      return nullptr;
+
+    current = std::move(output.front());
+    output.pop_front();
+    return current.c_str();
+  }
+
+  bool Instance::command(const std::string &cmd)
+  {
+    std::istringstream is(cmd);
+    std::string token;
+    is >> std::skipws >> token;
+
+    if (token == "quit" || token == "stop")
+      eng.stop();
+    else if (token == "ponderhit")
+      eng.set_ponderhit(false);
+    else if (token == "uci")
+    {
+      std::stringstream ss;
+      ss << "id name " << engine_info(true) << "\n"
+         << eng.get_options();
+      const std::string str = ss.str();
+      for (auto &line : split(str, "\n"))
+        if (!line.empty())
+          emit(std::string(line));
+      emit("uciok");
+    }
+    else if (scheduler && (token == "go" || token == "position" || token == "batch" || token == "flip"))
+      emit_info_string("'" + token + "' is not available once sessions are used, use 'session <id> " + token + "'");
+    else if (token == "setoption" && scheduler)
+    {
+      // Applied by the dispatcher between two jobs
+      std::string args;
+      std::getline(is, args);
+      scheduler->run_idle([this, args]()
+                          {
+                            std::istringstream as(args);
+                            eng.get_options().setoption(as); });
+    }
+    else if (token == "setoption")
+    {
+      eng.wait_for_search_finished();
+      eng.get_options().setoption(is);
+    }
+    else if (token == "go")
+      go(is);
+    else if (token == "position")
+      position(is);
+    else if (token == "ucinewgame" && scheduler)
+      scheduler->run_idle([this]()
+                          { eng.search_clear(); });
+    else if (token == "ucinewgame")
+      eng.search_clear();
+    else if (token == "isready")
+    {
+      eng.load_deferred_networks();
+      emit("readyok");
+    }
+    else if (token == "session")
+    {
+      if (!scheduler)
+      {
+        eng.wait_for_search_finished();
+        eng.set_info_formatting(true);
+        scheduler = std::make_unique<Scheduler>(eng, [this](std::string line)
+                                                { emit(std::move(line)); });
+      }
+      scheduler->command(is);
+    }
+    else if (token == "batch")
+      batch(is);
+    else if (token == "flip")
+      eng.flip();
+    else if (token == "d")
+    {
+      const std::string str = eng.visualize();
+      for (auto &line : split(str, "\n"))
+        emit(std::string(line));
+    }
+    else if (!token.empty() && token[0] != '#')
+      emit("Unknown command: '" + cmd + "'.");
+
+    return token != "quit";
+  }
+
+  void Instance::go(std::istringstream &is)
+  {
+    Search::LimitsType limits = UCIEngine::parse_limits(is);
+
+    if (limits.perft)
+    {
+      auto nodes = eng.perft(eng.fen(), limits.perft, eng.get_options()["UCI_Chess960"]);
+      emit("Nodes searched: " + std::to_string(nodes));
+    }
+    else
+      eng.go(limits);
+  }
+
+  void Instance::batch(std::istringstream &is)
+  {
+    bool inInputOrder;
+    std::vector<std::string> rejected;
+    std::string error;
+    auto items = UCIEngine::parse_batch(is, eng.get_options()["UCI_Chess960"], inInputOrder, rejected, error);
+
+    if (!items)
+    {
+      emit_info_string(error);
+      return;
+    }
+
+    for (const auto &fen : rejected)
+      emit_info_string("Skipping the invalid record " + fen);
+
+    const size_t total = items->size();
+    const TimePoint start = now();
+    auto searched = std::make_shared<std::atomic<size_t>>(0);
+
+    eng.start_batch(
+        std::move(*items), inInputOrder,
+        [this, searched](const Search::BatchResult &r)
+        {
+          ++*searched;
+          emit(UCIEngine::batch_result(r));
+        },
+        [this, searched, total, start]()
+        {
+          emit("batchdone positions " + std::to_string(*searched) + " of " + std::to_string(total) +
+               " time " + std::to_string(now() - start));
+        });
+  }
+
+  void Instance::position(std::istringstream &is)
+  {
+    std::string token, fen;
+
+    is >> token;
+
+    if (token == "startpos")
+    {
+      fen = StartFEN;
+      is >> token; // Consume the "moves" token, if any
+    }
+    else if (token == "fen")
+      while (is >> token && token != "moves")
+        fen += token + " ";
+    else
+      return;
+
+    std::vector<std::string> moves;
+
+    while (is >> token)
+      moves.push_back(token);
+
+    eng.set_position(fen, moves);
+  }
+
+} // namespace Stockfish
@@ -0,0 +1,79 @@
+#ifndef FLUTTER_STOCKFISH_INSTANCE_H
+#define FLUTTER_STOCKFISH_INSTANCE_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "../Stockfish/src/engine.h"
+#include "ffi.h"
+#include "scheduler.h"
+#include "spsc_ring.h"
+
+namespace Stockfish
+{
+
+  // An independent engine behind an FFI handle. Unlike stockfish_main() it
+  // does not own the process STDIN/STDOUT: every instance has its own
+  // ThreadPool, TT and options, and its output is queued per instance until
+  // the owner polls for it. The networks are shared between instances by the
+  // LazyNumaReplicatedSystemWide machinery of the Engine.
+  class Instance
+  {
+  public:
+    Instance();
+    ~Instance();
+
+    Instance(const Instance &) = delete;
+    Instance &operator=(const Instance &) = delete;
+
+    // Executes one UCI command line. Returns false once 'quit' was received.
+    bool command(const std::string &cmd);
+
+    // Returns the next output line, waiting at most timeoutMs for one to
+    // become available, or nullptr if there is none. The pointer stays valid
+    // until the next call to poll().
+    const char *poll(int timeoutMs);
+
+    // Switches the search updates from text lines to structured events
+    void open_events(size_t capacity);
+    // Returns the number of events copied, or -1 if events are not open
+    int read_events(stockfish_event *out, size_t maxCount);
+    size_t dropped_events() const { return events ? events->dropped_count() : 0; }
+
+    Engine &engine() { return eng; }
+
+  private:
+    void emit(std::string line);
+    void emit_info_string(std::string_view str);
+    void init_search_update_listeners();
+
+    template <typename... Args>
+    void push_event(const Args &...args);
+
+    void go(std::istringstream &is);
+    void batch(std::istringstream &is);
+    void position(std::istringstream &is);
+
+    Engine eng;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::string> output;
+    std::string current;
+
+    std::unique_ptr<SpscRing<stockfish_event>> events;
+
+    // Created by the first 'session' command, destroyed before the engine.
+    // From then on it owns the searches: 'go', 'position', 'batch' and 'flip'
+    // are rejected, 'setoption' and 'ucinewgame' run between two jobs.
+    std::unique_ptr<Scheduler> scheduler;
+  };
+
+} // namespace Stockfish
+
+#endif // #ifndef FLUTTER_STOCKFISH_INSTANCE_H
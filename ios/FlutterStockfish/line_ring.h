@@ -0,0 +1,201 @@
+#ifndef FLUTTER_STOCKFISH_LINE_RING_H
+#define FLUTTER_STOCKFISH_LINE_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace Stockfish
+{
+
+  // Wakes a sleeping reader. On Linux and Android this is an eventfd, whose
+  // counter keeps a ring issued before the reader goes to sleep; elsewhere a
+  // condition variable whose predicate is checked under the lock.
+  class Doorbell
+  {
+  public:
+#if defined(__linux__)
+    Doorbell() : fd(eventfd(0, EFD_CLOEXEC))
+    {
+    }
+    ~Doorbell() { close(fd); }
+
+    void ring()
+    {
+      uint64_t one = 1;
+      [[maybe_unused]] ssize_t n = ::write(fd, &one, sizeof(one));
+    }
+
+    template <typename Pred>
+    void wait(Pred ready)
+    {
+      while (!ready())
+      {
+        uint64_t count;
+        [[maybe_unused]] ssize_t n = ::read(fd, &count, sizeof(count));
+      }
+    }
+
+  private:
+    int fd;
+#else
+    void ring()
+    {
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+      }
+      cv.notify_one();
+    }
+
+    template <typename Pred>
+    void wait(Pred ready)
+    {
+      std::unique_lock<std::mutex> lk(mutex);
+      cv.wait(lk, ready);
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable cv;
+#endif
+  };
+
+  // Lock-free single-producer/single-consumer byte ring carrying text lines.
+  // The producer publishes whole lines only, so the reader never sees a line
+  // split in the middle, and a single drain() returns every complete line
+  // available. The reader is woken through the doorbell only when the ring
+  // goes from empty to non-empty.
+  class LineRing
+  {
+  public:
+    // The capacity is rounded up to a power of two
+    explicit LineRing(size_t capacity)
+    {
+      size_t n = 1;
+      while (n < capacity)
+        n <<= 1;
+
+      mask = n - 1;
+      buffer = std::make_unique<char[]>(n);
+    }
+
+    LineRing(const LineRing &) = delete;
+    LineRing &operator=(const LineRing &) = delete;
+
+    // Producer side: appends n bytes, which should end with '\n', and
+    // publishes them at once. Blocks while the ring is full. Lines longer
+    // than the capacity are published in capacity sized pieces.
+    void write(const char *data, size_t n)
+    {
+      while (n > 0)
+      {
+        const size_t chunk = n < mask + 1 ? n : mask + 1;
+        const size_t t = tail.load(std::memory_order_relaxed);
+
+        for (int spins = 0; t + chunk - head.load(std::memory_order_acquire) > mask + 1; ++spins)
+          if (spins < 64)
+            std::this_thread::yield();
+          else
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+        const size_t start = t & mask;
+        const size_t first = chunk < mask + 1 - start ? chunk : mask + 1 - start;
+        std::memcpy(&buffer[start], data, first);
+        std::memcpy(&buffer[0], data + first, chunk - first);
+
+        tail.store(t + chunk, std::memory_order_seq_cst);
+
+        // Only the reader can have gone to sleep if it had consumed everything
+        if (head.load(std::memory_order_seq_cst) == t)
+          doorbell.ring();
+
+        data += chunk;
+        n -= chunk;
+      }
+    }
+
+    // Consumer side: blocks until data is available, then appends all of it
+    // to out and returns the number of bytes appended.
+    size_t drain(std::vector<char> &out)
+    {
+      const size_t h = head.load(std::memory_order_relaxed);
+      doorbell.wait([&]
+                    { return tail.load(std::memory_order_seq_cst) != h; });
+
+      const size_t t = tail.load(std::memory_order_acquire);
+      const size_t n = t - h;
+      const size_t start = h & mask;
+      const size_t first = n < mask + 1 - start ? n : mask + 1 - start;
+
+      out.insert(out.end(), &buffer[start], &buffer[start] + first);
+      out.insert(out.end(), &buffer[0], &buffer[0] + (n - first));
+
+      head.store(t, std::memory_order_seq_cst);
+      return n;
+    }
+
+  private:
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t mask;
+    std::unique_ptr<char[]> buffer;
+    Doorbell doorbell;
+  };
+
+  // Stream buffer that collects what is written to it and forwards every
+  // complete line to a LineRing. Writers must be serialized, which holds for
+  // std::cout in Stockfish as output goes through sync_cout.
+  class LineRingStreambuf : public std::streambuf
+  {
+  public:
+    explicit LineRingStreambuf(LineRing &r) : ring(r) {}
+
+  protected:
+    int_type overflow(int_type c) override
+    {
+      if (c != traits_type::eof())
+      {
+        pending.push_back(char(c));
+        if (c == '\n')
+          flush_lines();
+      }
+      return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+      pending.append(s, size_t(n));
+      if (std::memchr(s, '\n', size_t(n)))
+        flush_lines();
+      return n;
+    }
+
+  private:
+    void flush_lines()
+    {
+      const size_t end = pending.rfind('\n') + 1;
+      ring.write(pending.data(), end);
+      pending.erase(0, end);
+    }
+
+    LineRing &ring;
+    std::string pending;
+  };
+
+} // namespace Stockfish
+
+#endif // #ifndef FLUTTER_STOCKFISH_LINE_RING_H
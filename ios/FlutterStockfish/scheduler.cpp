@@ -0,0 +1,391 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <tuple>
+#include <utility>
+
+#include "../Stockfish/src/uci.h"
+
+namespace Stockfish
+{
+
+  namespace
+  {
+
+    // Ordering of the queue: lower is served first
+    auto rank(int priority, TimePoint deadline, uint64_t lastServed, uint64_t seq)
+    {
+      return std::make_tuple(priority, deadline ? deadline : std::numeric_limits<TimePoint>::max(), lastServed, seq);
+    }
+
+  } // namespace
+
+  Scheduler::Scheduler(Engine &engine, Emit e) : eng(engine), emit(std::move(e))
+  {
+    dispatcher = std::thread(&Scheduler::run, this);
+  }
+
+  Scheduler::~Scheduler()
+  {
+    {
+      std::lock_guard<std::mutex> lk(mutex);
+      quit = true;
+      if (running)
+        eng.stop();
+    }
+    cv.notify_all();
+    dispatcher.join();
+  }
+
+  void Scheduler::emit_line(const std::string &session, const std::string &line)
+  {
+    emit("session " + session + " " + line);
+  }
+
+  void Scheduler::run_idle(std::function<void()> task)
+  {
+    {
+      std::lock_guard<std::mutex> lk(mutex);
+      tasks.push_back(std::move(task));
+    }
+    cv.notify_all();
+  }
+
+  bool Scheduler::on_iter(const Engine::InfoIter &info)
+  {
+    std::unique_lock<std::mutex> lk(mutex);
+    if (!running)
+      return false;
+
+    const std::string session = running->session;
+    lk.unlock();
+    emit_line(session, UCIEngine::info_iter(info));
+    return true;
+  }
+
+  bool Scheduler::on_update_no_moves(const Engine::InfoShort &info)
+  {
+    std::unique_lock<std::mutex> lk(mutex);
+    if (!running)
+      return false;
+
+    const std::string session = running->session;
+    lk.unlock();
+    emit_line(session, UCIEngine::info_no_moves(info));
+    return true;
+  }
+
+  bool Scheduler::on_update_full(const Engine::InfoFull &info)
+  {
+    std::unique_lock<std::mutex> lk(mutex);
+    if (!running)
+      return false;
+
+    const std::string session = running->session;
+    lastDepth = info.depth;
+    lastNodes = info.nodes;
+    lk.unlock();
+    emit_line(session, UCIEngine::info_full(info, eng.get_options()["UCI_ShowWDL"]));
+    return true;
+  }
+
+  // The bestmove of a slice is held back until the job is finished
+  bool Scheduler::on_bestmove(std::string_view bestmove, std::string_view ponder)
+  {
+    std::unique_lock<std::mutex> lk(mutex);
+    if (!running)
+      return false;
+
+    running->bestmove = std::string(bestmove);
+    running->ponder = std::string(ponder);
+    sliceDone = true;
+    lk.unlock();
+    cv.notify_all();
+    return true;
+  }
+
+  void Scheduler::command(std::istringstream &is)
+  {
+    std::string id, token;
+    is >> id >> token;
+
+    if (id.empty())
+      return;
+
+    std::unique_lock<std::mutex> lk(mutex);
+
+    if (token == "config")
+    {
+      Session &s = sessions[id];
+      while (is >> token)
+        if (token == "priority")
+          is >> s.priority, s.priority = std::clamp(s.priority, 0, 2);
+        else if (token == "multipv")
+          is >> s.multiPV, s.multiPV = std::max(s.multiPV, 1);
+        else if (token == "history")
+          is >> token, s.clearHistory = token == "clear";
+        else if (token == "hash")
+          is >> s.hashMB;
+    }
+    else if (token == "clearhash")
+      sessions[id].clearHash = true;
+    else if (token == "position")
+    {
+      Session &s = sessions[id];
+      s.fen.clear();
+      s.moves.clear();
+
+      is >> token;
+      if (token == "startpos")
+      {
+        s.fen = StartFEN;
+        is >> token; // Consume the "moves" token, if any
+      }
+      else if (token == "fen")
+        while (is >> token && token != "moves")
+          s.fen += token + " ";
+
+      while (is >> token)
+        s.moves.push_back(token);
+    }
+    else if (token == "go")
+    {
+      Job job;
+      job.session = id;
+      job.seq = ++seq;
+
+      // The deadline is not a UCI limit, so it is taken out before parsing
+      std::string limits;
+      TimePoint ms;
+      while (is >> token)
+        if (token == "deadline" && is >> ms)
+          job.deadline = now() + ms;
+        else
+          limits += token + " ";
+
+      std::istringstream ls(limits);
+      job.limits = UCIEngine::parse_limits(ls);
+      job.limits.ponderMode = false;
+
+      // Time management and mate searches need the whole search to be meaningful
+      job.preemptible = !job.limits.use_time_management() && !job.limits.mate;
+
+      sessions.try_emplace(id);
+      queue.push_back(std::move(job));
+      lk.unlock();
+      cv.notify_all();
+    }
+    else if (token == "stop" || token == "close")
+    {
+      // A stopped queued job reports the best move of its last slice, if any
+      for (auto it = queue.begin(); it != queue.end();)
+        if (it->session == id)
+        {
+          finish(*it, false);
+          it = queue.erase(it);
+        }
+        else
+          ++it;
+
+      if (running && running->session == id)
+      {
+        stopRequested = true;
+        eng.stop();
+      }
+
+      if (token == "close")
+      {
+        auto s = sessions.find(id);
+        if (s != sessions.end() && s->second.hashMB)
+        {
+          released.push_back(id);
+          cv.notify_all();
+        }
+        sessions.erase(id);
+      }
+    }
+    else
+      emit("Unknown command: 'session " + id + " " + token + "'.");
+  }
+
+  std::vector<Scheduler::Job>::iterator Scheduler::next_job()
+  {
+    return std::min_element(queue.begin(), queue.end(), [&](const Job &a, const Job &b)
+                            {
+                              const Session &sa = sessions[a.session];
+                              const Session &sb = sessions[b.session];
+                              return rank(sa.priority, a.deadline, sa.lastServed, a.seq) <
+                                     rank(sb.priority, b.deadline, sb.lastServed, b.seq); });
+  }
+
+  bool Scheduler::should_preempt(const Job &job, TimePoint sliceStart) const
+  {
+    const auto s = sessions.find(job.session);
+    if (!job.preemptible || s == sessions.end())
+      return false;
+
+    const int priority = s->second.priority;
+
+    for (const Job &other : queue)
+    {
+      const auto it = sessions.find(other.session);
+      const int p = it != sessions.end() ? it->second.priority : 1;
+
+      if (p < priority || (p == priority && now() - sliceStart >= Quantum))
+        return true;
+    }
+
+    return false;
+  }
+
+  void Scheduler::finish(const Job &job, bool deadlineMissed)
+  {
+    if (deadlineMissed)
+      emit_line(job.session, "info string deadline missed");
+
+    emit_line(job.session, UCIEngine::bestmove(job.bestmove.empty() ? "(none)" : job.bestmove, job.ponder));
+  }
+
+  void Scheduler::run()
+  {
+    std::unique_lock<std::mutex> lk(mutex);
+
+    while (true)
+    {
+      cv.wait(lk, [&]
+              { return quit || !queue.empty() || !released.empty() || !tasks.empty(); });
+
+      if (quit)
+        break;
+
+      // The engine is idle between slices, so the TT can be changed now
+      if (!released.empty())
+      {
+        const std::vector<std::string> names = std::move(released);
+        released.clear();
+        lk.unlock();
+        for (const auto &name : names)
+          eng.set_tt_partition(name, 0);
+        lk.lock();
+        continue;
+      }
+
+      if (!tasks.empty())
+      {
+        const std::vector<std::function<void()>> pending = std::move(tasks);
+        tasks.clear();
+        lk.unlock();
+        for (const auto &task : pending)
+          task();
+        lk.lock();
+        continue;
+      }
+
+      auto it = next_job();
+      Job job = std::move(*it);
+      queue.erase(it);
+
+      if (job.deadline && job.deadline <= now())
+      {
+        finish(job, true);
+        continue;
+      }
+
+      run_slice(lk, job);
+    }
+  }
+
+  void Scheduler::run_slice(std::unique_lock<std::mutex> &lk, Job &job)
+  {
+    Session &session = sessions[job.session];
+    session.lastServed = ++served;
+
+    const bool clear = session.clearHistory && lastSession != job.session;
+    const std::string fen = session.fen.empty() ? StartFEN : session.fen;
+    const std::vector<std::string> moves = session.moves;
+    const int multiPV = session.multiPV;
+    const size_t hashMB = session.hashMB;
+    const bool clearHash = std::exchange(session.clearHash, false);
+
+    // The slice may not outlive the deadline
+    Search::LimitsType limits = job.limits;
+    if (job.deadline)
+      limits.movetime = std::max<TimePoint>(1, std::min(limits.movetime ? limits.movetime : job.deadline - now(),
+                                                        job.deadline - now()));
+
+    running = &job;
+    sliceDone = stopRequested = false;
+    lastDepth = 0;
+    lastNodes = 0;
+    lastSession = job.session;
+    lk.unlock();
+
+    if (clear)
+      eng.clear_histories();
+
+    // Sizing releases the part of a session back to hash 0
+    const bool ownHash = eng.set_tt_partition(job.session, hashMB) && hashMB;
+    if (hashMB && !ownHash)
+      emit_line(job.session, "info string No room for " + std::to_string(hashMB) + " MB of hash, using the common hash");
+
+    if (clearHash && ownHash)
+      eng.clear_tt_partition(job.session);
+
+    eng.select_tt_partition(ownHash ? job.session : "");
+
+    std::istringstream mpv("name MultiPV value " + std::to_string(multiPV));
+    eng.get_options().setoption(mpv);
+    eng.set_position(fen, moves);
+
+    const TimePoint sliceStart = now();
+    limits.startTime = sliceStart;
+    eng.go(limits);
+
+    lk.lock();
+    bool preempted = false;
+    while (!sliceDone)
+    {
+      cv.wait_for(lk, std::chrono::milliseconds(5));
+
+      // Repeated, as a stop that arrives before go() has started is reset by it
+      if (quit || stopRequested)
+        eng.stop();
+      else if (!preempted && should_preempt(job, sliceStart))
+      {
+        eng.stop_after_iteration();
+        preempted = true;
+      }
+    }
+    lk.unlock();
+
+    eng.wait_for_search_finished();
+    eng.select_tt_partition("");
+
+    lk.lock();
+    running = nullptr;
+
+    // A preempted search may also have reached its own limits in the last iteration
+    const TimePoint used = now() - sliceStart;
+    const bool exhausted = (job.limits.depth && lastDepth >= job.limits.depth) ||
+                           (job.limits.movetime && used >= job.limits.movetime) ||
+                           (job.limits.nodes && lastNodes >= job.limits.nodes);
+
+    // With no limit of its own, a job simply runs until its deadline
+    const bool ownLimits = job.limits.depth || job.limits.movetime || job.limits.nodes;
+    const bool deadlineMissed = job.deadline && now() >= job.deadline && ownLimits && !exhausted;
+
+    if (preempted && !quit && !stopRequested && !exhausted && !deadlineMissed)
+    {
+      // Charge the slice to the budget of the job
+      job.limits.movetime -= std::min(job.limits.movetime, used);
+      job.limits.nodes -= std::min(job.limits.nodes, lastNodes);
+      queue.push_back(std::move(job));
+      return;
+    }
+
+    finish(job, deadlineMissed);
+  }
+
+} // namespace Stockfish
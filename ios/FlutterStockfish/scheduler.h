@@ -0,0 +1,128 @@
+#ifndef FLUTTER_STOCKFISH_SCHEDULER_H
+#define FLUTTER_STOCKFISH_SCHEDULER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../Stockfish/src/engine.h"
+#include "../Stockfish/src/misc.h"
+
+namespace Stockfish
+{
+
+  // Time-shares the threads, TT and networks of one Engine between logical
+  // analysis sessions. Every session has its own position, MultiPV, priority
+  // class and history policy, and queues 'go' jobs. The dispatcher runs one
+  // job at a time on the whole thread pool, choosing by priority class, then
+  // earliest deadline, then the session served least recently. A running job
+  // is preempted at the end of an iteration when a job of a better class
+  // arrives, or when its quantum expires and a job of the same class waits;
+  // it is then queued again with its remaining budget, and finds its earlier
+  // work in the shared TT.
+  //
+  // A session configured with a hash size gets a part of the TT of its own,
+  // which 'ucinewgame' and the other sessions leave alone and whose fill is
+  // what its 'hashfull' reports. Other sessions share the common part.
+  //
+  // Commands, all prefixed with "session <id>":
+  //   config [priority 0|1|2] [multipv <n>] [history keep|clear] [hash <mb>]
+  //   position startpos|fen <fen> [moves ...]
+  //   go <limits> [deadline <ms>]
+  //   clearhash
+  //   stop
+  //   close
+  // Output lines of a job are prefixed with "session <id> "; sessions report
+  // text lines only, not structured events. Hash changes are applied before
+  // the next search of the session.
+  //
+  // The owner of the engine keeps its search update listeners and passes the
+  // updates on to the on_*() functions, which take those of a running job.
+  class Scheduler
+  {
+  public:
+    using Emit = std::function<void(std::string)>;
+
+    static constexpr TimePoint Quantum = 250;
+
+    Scheduler(Engine &engine, Emit emit);
+    ~Scheduler();
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    void command(std::istringstream &is);
+
+    // Runs task on the dispatcher thread while no job is being searched
+    void run_idle(std::function<void()> task);
+
+    // Return false if no job is running, leaving the update to the caller
+    bool on_iter(const Engine::InfoIter &info);
+    bool on_update_no_moves(const Engine::InfoShort &info);
+    bool on_update_full(const Engine::InfoFull &info);
+    bool on_bestmove(std::string_view bestmove, std::string_view ponder);
+
+  private:
+    struct Session
+    {
+      std::string fen;
+      std::vector<std::string> moves;
+      int multiPV = 1;
+      int priority = 1; // 0 interactive, 1 normal, 2 background
+      bool clearHistory = false;
+      size_t hashMB = 0; // own part of the TT, 0 for the common part
+      bool clearHash = false;
+      uint64_t lastServed = 0;
+    };
+
+    struct Job
+    {
+      std::string session;
+      Search::LimitsType limits;
+      TimePoint deadline = 0; // absolute, 0 for none
+      uint64_t seq = 0;
+      bool preemptible = true;
+      std::string bestmove, ponder; // result of the last completed slice
+    };
+
+    void run();
+    void run_slice(std::unique_lock<std::mutex> &lk, Job &job);
+    bool should_preempt(const Job &job, TimePoint sliceStart) const;
+    std::vector<Job>::iterator next_job();
+    void finish(const Job &job, bool deadlineMissed);
+
+    void emit_line(const std::string &session, const std::string &line);
+
+    Engine &eng;
+    Emit emit;
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::map<std::string, Session> sessions;
+    std::vector<Job> queue;
+    std::vector<std::string> released; // sessions closed with a part of the TT
+    std::vector<std::function<void()>> tasks;
+    uint64_t seq = 0, served = 0;
+    bool quit = false;
+
+    // State of the slice being searched, guarded by mutex
+    Job *running = nullptr;
+    bool sliceDone = false, stopRequested = false;
+    int lastDepth = 0;
+    uint64_t lastNodes = 0;
+    std::string lastSession;
+
+    std::thread dispatcher;
+  };
+
+} // namespace Stockfish
+
+#endif // #ifndef FLUTTER_STOCKFISH_SCHEDULER_H
@@ -0,0 +1,80 @@
+#ifndef FLUTTER_STOCKFISH_SPSC_RING_H
+#define FLUTTER_STOCKFISH_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace Stockfish
+{
+
+  // Lock-free single-producer/single-consumer ring of fixed size records.
+  // All slots are allocated up front and the producer fills them in place,
+  // so pushing an event costs no allocation and no lock. The head and tail
+  // indices live on separate cache lines to avoid false sharing between the
+  // engine thread and the reader.
+  template <typename T>
+  class SpscRing
+  {
+  public:
+    // The capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity)
+    {
+      size_t n = 1;
+      while (n < capacity)
+        n <<= 1;
+
+      mask = n - 1;
+      slots = std::make_unique<T[]>(n);
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    // Producer side: returns the next free slot, or nullptr if the ring is
+    // full. The slot is published only by a following commit().
+    T *claim()
+    {
+      const size_t t = tail.load(std::memory_order_relaxed);
+      if (t - head.load(std::memory_order_acquire) > mask)
+      {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+      }
+
+      return &slots[t & mask];
+    }
+
+    void commit() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer side: copies up to maxCount records to out and returns how many
+    // were copied.
+    size_t drain(T *out, size_t maxCount)
+    {
+      const size_t h = head.load(std::memory_order_relaxed);
+      const size_t available = tail.load(std::memory_order_acquire) - h;
+      const size_t count = available < maxCount ? available : maxCount;
+
+      for (size_t i = 0; i < count; ++i)
+        out[i] = slots[(h + i) & mask];
+
+      head.store(h + count, std::memory_order_release);
+      return count;
+    }
+
+    // Number of records that were lost because the consumer fell behind
+    size_t dropped_count() const { return dropped.load(std::memory_order_relaxed); }
+
+  private:
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<size_t> dropped{0};
+    size_t mask;
+    std::unique_ptr<T[]> slots;
+  };
+
+} // namespace Stockfish
+
+#endif // #ifndef FLUTTER_STOCKFISH_SPSC_RING_H
@@ -512,4 +512,13 @@ BenchmarkSetup setup_benchmark(std::istream& is) {
     return setup;
 }
 
+std::vector<std::string> benchmark_positions() {
+    std::vector<std::string> fens;
+
+    for (const auto& game : BenchmarkPositions)
+        fens.insert(fens.end(), game.begin(), game.end());
+
+    return fens;
+}
+
 }  // namespace Stockfish
@@ -37,6 +37,9 @@ struct BenchmarkSetup {
 
 BenchmarkSetup setup_benchmark(std::istream&);
 
+// The positions of the games of the benchmark, for evaluation benchmarks
+std::vector<std::string> benchmark_positions();
+
 }  // namespace Stockfish
 
 #endif  // #ifndef BENCHMARK_H_INCLUDED
@@ -19,10 +19,14 @@
 #include "engine.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <deque>
 #include <iosfwd>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <sstream>
 #include <string_view>
@@ -48,9 +52,8 @@ namespace Stockfish {
 
 namespace NN = Eval::NNUE;
 
-constexpr auto StartFEN   = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
-constexpr int  MaxHashMB  = Is64Bit ? 33554432 : 2048;
-int            MaxThreads = std::max(1024, 4 * int(get_hardware_concurrency()));
+constexpr int MaxHashMB  = Is64Bit ? 33554432 : 2048;
+int           MaxThreads = std::max(1024, 4 * int(get_hardware_concurrency()));
 
 // The default configuration will attempt to group L3 domains up to 32 threads.
 // This size was found to be a good balance between the Elo gain of increased
@@ -58,17 +61,40 @@ int            MaxThreads = std::max(1024, 4 * int(get_hardware_concurrency()));
 // PR#6526). The user can always explicitly override this behavior.
 constexpr NumaAutoPolicy DefaultNumaPolicy = BundledL3Policy{32};
 
+namespace {
+
+// Identifies a loaded set of networks across all engines of the process
+std::atomic<std::uint64_t> lastNetworksId{0};
+
+// Accumulators used by Engine::evaluate_positions() on the calling thread. The
+// refresh caches hold the network biases, so they are rebuilt after a reload.
+struct EvalScratch {
+    std::uint64_t                          networksId = 0;
+    std::unique_ptr<NN::AccumulatorStack>  accumulators;
+    std::unique_ptr<NN::AccumulatorCaches> caches;
+};
+
+thread_local EvalScratch evalScratch;
+
+std::uint64_t microseconds_since(std::chrono::steady_clock::time_point start) {
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count());
+}
+
+}  // namespace
+
 Engine::Engine(std::optional<std::string> path) :
     binaryDirectory(path ? CommandLine::get_binary_directory(*path) : ""),
     numaContext(NumaConfig::from_system(DefaultNumaPolicy)),
     states(new std::deque<StateInfo>(1)),
     threads(),
     networks(numaContext,
-             // Heap-allocate because sizeof(NN::Networks) is large
-             std::make_unique<NN::Networks>(NN::EvalFile{EvalFileDefaultNameBig, "None", ""},
-                                            NN::EvalFile{EvalFileDefaultNameSmall, "None", ""})) {
+             NN::EvalFile{EvalFileDefaultNameBig, "None", ""},
+             NN::EvalFile{EvalFileDefaultNameSmall, "None", ""}) {
 
     pos.set(StartFEN, false, &states->back());
+    positionFen = StartFEN;
 
     options.add(  //
       "Debug Log File", Option("", [](const Option& o) {
@@ -90,11 +116,56 @@ Engine::Engine(std::optional<std::string> path) :
       }));
 
     options.add(  //
-      "Hash", Option(16, 1, MaxHashMB, [this](const Option& o) {
-          set_tt_size(o);
+      "Hash", Option(16, 1, MaxHashMB, [this](const Option& o) -> std::optional<std::string> {
+          // A table shared with other processes is attached at its new size instead
+          if (tt.is_shared())
+          {
+              set_tt_size(o);
+              return std::nullopt;
+          }
+
+          const TimePoint   start = now();
+          const TTMigration m     = migrate_tt(o);
+
+          if (!m.entries)
+              return std::nullopt;
+
+          return "Hash resized in " + std::to_string(now() - start) + " ms, kept "
+               + std::to_string(m.kept) + " of " + std::to_string(m.entries) + " entries ("
+               + std::to_string(m.kept * 100 / m.entries) + "%)";
+      }));
+
+    // A few hundred KB, to fit in the L2 cache of a core
+    options.add(  //
+      "ThreadHashCache", Option(0, 0, 16384, [this](const Option& o) {
+          set_tt_cache_size(o);
           return std::nullopt;
       }));
 
+    // Spreads the hash over the NUMA nodes of the threads, see TTPlacement
+    options.add(  //
+      "HashPlacement", Option("interleave var interleave var shards", "interleave",
+                              [this](const Option& o) {
+                                  set_tt_placement(o == "shards" ? TTPlacement::Shards
+                                                                 : TTPlacement::Interleave);
+                                  return std::nullopt;
+                              }));
+
+    // Processes with the same name and Hash size search with one common table
+    options.add(  //
+      "SharedHashName", Option("", [this](const Option& o) -> std::optional<std::string> {
+          set_tt_size(options["Hash"]);
+
+          if (std::string(o).empty())
+              return std::nullopt;
+
+          if (tt.is_shared())
+              return "Shared hash attached, used by " + std::to_string(tt.shared_users())
+                   + " process(es)";
+
+          return "Shared hash not available, using a private one";
+      }));
+
     options.add(  //
       "Clear Hash", Option([this](const Option&) {
           search_clear();
@@ -104,6 +175,18 @@ Engine::Engine(std::optional<std::string> path) :
     options.add(  //
       "Ponder", Option(false));
 
+    // A search whose root follows the PV of the previous one starts from it. Off
+    // until its effect on play is measured in games.
+    options.add("SearchReuse", Option(false));
+
+    // Pondering splits the threads over as many replies of the opponent
+    options.add("PonderCandidates", Option(1, 1, 16));
+
+    // After bestmove, the search goes on after the expected reply, using at
+    // most BackgroundCPU percent of the time of each thread
+    options.add("BackgroundSearch", Option(false));
+    options.add("BackgroundCPU", Option(25, 1, 100));
+
     options.add(  //
       "MultiPV", Option(1, 1, MAX_MOVES));
 
@@ -147,11 +230,23 @@ Engine::Engine(std::optional<std::string> path) :
           return std::nullopt;
       }));
 
-    load_networks();
+    // Evaluates with the small network only, without loading the big one
+    options.add(  //
+      "LowMemory", Option(false, [this](const Option& o) {
+          set_low_memory(o);
+          return std::nullopt;
+      }));
+
+    // The big network is read by load_deferred_networks(), once it is needed,
+    // so that setting LowMemory first keeps it out of memory altogether
+    reload_networks(std::nullopt, std::string(options["EvalFileSmall"]));
     resize_threads();
+
+    startupStats.created = microseconds_since(constructionStart);
 }
 
 std::uint64_t Engine::perft(const std::string& fen, Depth depth, bool isChess960) {
+    load_deferred_networks();
     verify_networks();
 
     return Benchmark::perft(fen, depth, isChess960);
@@ -159,11 +254,57 @@ std::uint64_t Engine::perft(const std::string& fen, Depth depth, bool isChess960
 
 void Engine::go(Search::LimitsType& limits) {
     assert(limits.perft == 0);
+    load_deferred_networks();
     verify_networks();
 
     threads.start_thinking(options, pos, states, limits);
 }
+
+void Engine::start_batch(std::vector<Search::BatchItem>                 items,
+                         bool                                            inItemOrder,
+                         std::function<void(const Search::BatchResult&)> onResult,
+                         std::function<void()>                           onDone) {
+    load_deferred_networks();
+    verify_networks();
+    wait_for_search_finished();
+
+    if (inItemOrder)
+    {
+        // Results that complete early wait here until those before them are in
+        struct Reorder {
+            std::mutex                                      mutex;
+            std::map<size_t, Search::BatchResult>           pending;
+            size_t                                          next = 0;
+            std::function<void(const Search::BatchResult&)> report;
+        };
+
+        auto r    = std::make_shared<Reorder>();
+        r->report = std::move(onResult);
+
+        onResult = [r](const Search::BatchResult& result) {
+            std::lock_guard<std::mutex> lk(r->mutex);
+            r->pending.emplace(result.index, result);
+
+            for (auto it = r->pending.begin(); it != r->pending.end() && it->first == r->next;
+                 it      = r->pending.erase(it), ++r->next)
+                r->report(it->second);
+        };
+
+        // A stopped batch leaves gaps, so whatever is left is flushed at the end
+        onDone = [r, done = std::move(onDone)]() {
+            for (const auto& [index, result] : r->pending)
+                r->report(result);
+            done();
+        };
+    }
+
+    tt.new_search();
+    threads.start_batch(std::make_shared<const std::vector<Search::BatchItem>>(std::move(items)),
+                        std::move(onResult), std::move(onDone));
+}
+
 void Engine::stop() { threads.stop = true; }
+void Engine::stop_after_iteration() { threads.stopAfterIteration = true; }
 
 void Engine::search_clear() {
     wait_for_search_finished();
@@ -175,6 +316,38 @@ void Engine::search_clear() {
     Tablebases::init(options["SyzygyPath"]);  // Free mapped files
 }
 
+void Engine::clear_histories() {
+    wait_for_search_finished();
+
+    threads.clear();
+}
+
+bool Engine::set_tt_partition(const std::string& name, size_t mb) {
+    wait_for_search_finished();
+    return tt.set_partition(name, mb, threads);
+}
+
+void Engine::clear_tt_partition(const std::string& name) {
+    wait_for_search_finished();
+    tt.clear_partition(name, threads);
+}
+
+void Engine::select_tt_partition(const std::string& name) {
+    wait_for_search_finished();
+    tt.select_partition(name);
+}
+
+bool Engine::save_hash(const std::string& path, int maxAge) {
+    wait_for_search_finished();
+    return tt.save(path, networks.get_content_hash(), maxAge);
+}
+
+TTFileStatus Engine::load_hash(const std::string& path) {
+    wait_for_search_finished();
+
+    return tt.load(path, networks.get_content_hash(), threads);
+}
+
 void Engine::set_on_update_no_moves(std::function<void(const Engine::InfoShort&)>&& f) {
     updateContext.onUpdateNoMoves = std::move(f);
 }
@@ -195,22 +368,68 @@ void Engine::set_on_verify_networks(std::function<void(std::string_view)>&& f) {
     onVerifyNetworks = std::move(f);
 }
 
-void Engine::wait_for_search_finished() { threads.main_thread()->wait_for_search_finished(); }
+void Engine::set_info_formatting(bool b) { updateContext.formatInfo = b; }
+
+void Engine::wait_for_search_finished() {
+    threads.end_background();
+    threads.main_thread()->wait_for_search_finished();
+
+    // Helper threads may still be searching their own items of a batch
+    threads.wait_for_search_finished();
+}
 
 void Engine::set_position(const std::string& fen, const std::vector<std::string>& moves) {
-    // Drop the old state and create a new one
-    states = StateListPtr(new std::deque<StateInfo>(1));
-    pos.set(fen, options["UCI_Chess960"], &states->back());
+    const bool chess960 = options["UCI_Chess960"];
+
+    // A search in the background still reads the states
+    threads.end_background();
+
+    // The moves in common with those of the current position are kept: the
+    // others are undone and the new ones played, on the states of the current
+    // position, which the last search may have taken. Its earlier states stay
+    // where they are, which the search reuse needs. When more moves would be
+    // undone than kept, or a running search still reads the states, the
+    // position is set up from scratch instead: states taken from a running
+    // search could be freed or popped by the next position command.
+    const bool sameStart = fen == positionFen && chess960 == pos.is_chess960();
+    size_t     common    = 0;
+
+    if (sameStart)
+        while (common < positionMoves.size() && common < moves.size()
+               && positionMoves[common].uci == moves[common])
+            ++common;
+
+    bool keep = sameStart && positionMoves.size() - common <= common;
+
+    if (keep && !states)
+        keep = !threads.main_thread()->is_searching() && (states = threads.take_setup_states());
+
+    if (keep)
+        while (positionMoves.size() > common)
+        {
+            pos.undo_move(positionMoves.back().move);
+            states->pop_back();
+            positionMoves.pop_back();
+        }
+    else
+    {
+        // Drop the old state and create a new one
+        states = StateListPtr(new std::deque<StateInfo>(1));
+        pos.set(fen, chess960, &states->back());
+        positionFen = fen;
+        positionMoves.clear();
+    }
 
-    for (const auto& move : moves)
+    for (size_t i = positionMoves.size(); i < moves.size(); ++i)
     {
-        auto m = UCIEngine::to_move(pos, move);
+        auto m = UCIEngine::to_move(pos, moves[i]);
 
         if (m == Move::none())
             break;
 
         states->emplace_back();
         pos.do_move(m, states->back());
+        positionMoves.push_back({moves[i], m});
     }
 }
 
@@ -247,12 +466,36 @@ void Engine::resize_threads() {
 
     // Reallocate the hash with the new threadpool size
     set_tt_size(options["Hash"]);
+    set_tt_cache_size(options["ThreadHashCache"]);
     threads.ensure_network_replicated();
 }
 
 void Engine::set_tt_size(size_t mb) {
     wait_for_search_finished();
-    tt.resize(mb, threads);
+    tt.resize(mb, threads, options["SharedHashName"]);
+}
+
+TTMigration Engine::migrate_tt(size_t mb) {
+    wait_for_search_finished();
+    return tt.migrate(mb, threads);
+}
+
+// The pages are placed when the table is allocated, so it is allocated again
+void Engine::set_tt_placement(TTPlacement p) {
+    tt.set_placement(p);
+    set_tt_size(options["Hash"]);
+}
+
+void Engine::set_tt_cache_size(size_t kb) {
+    wait_for_search_finished();
+
+    for (size_t i = 0; i < threads.num_threads(); ++i)
+        threads.run_on_thread(i, [this, i, kb]() {
+            (*(threads.begin() + i))->worker->ttCache.resize(kb);
+        });
+
+    for (size_t i = 0; i < threads.num_threads(); ++i)
+        threads.wait_on_thread(i);
 }
 
 void Engine::set_ponderhit(bool b) { threads.main_manager()->ponder = b; }
@@ -260,10 +503,24 @@ void Engine::set_ponderhit(bool b) { threads.main_manager()->ponder = b; }
 // network related
 
 void Engine::verify_networks() const {
-    networks->big.verify(options["EvalFile"], onVerifyNetworks);
-    networks->small.verify(options["EvalFileSmall"], onVerifyNetworks);
+    if (networks.big)
+        (*networks.big)->verify(options["EvalFile"], onVerifyNetworks);
+    networks.small->verify(options["EvalFileSmall"], onVerifyNetworks);
+
+    // Both networks are replicated on the same nodes. The big one, when loaded,
+    // is the one worth sharing, but an error of the small one is reported too.
+    auto statuses = networks.small.get_status_and_errors();
+    if (networks.big)
+    {
+        auto bigStatuses = networks.big->get_status_and_errors();
+        for (size_t i = 0; i < statuses.size(); ++i)
+            if (!bigStatuses[i].second.has_value())
+                bigStatuses[i].second = statuses[i].second;
+        statuses = std::move(bigStatuses);
+    }
+    else
+        onVerifyNetworks("Low memory: the big network is not loaded.");
 
-    auto statuses = networks.get_status_and_errors();
     for (size_t i = 0; i < statuses.size(); ++i)
     {
         const auto [status, error] = statuses[i];
@@ -294,54 +551,139 @@ void Engine::verify_networks() const {
     }
 }
 
-void Engine::load_networks() {
-    networks.modify_and_replicate([this](NN::Networks& networks_) {
-        networks_.big.load(binaryDirectory, options["EvalFile"]);
-        networks_.small.load(binaryDirectory, options["EvalFileSmall"]);
-    });
+void Engine::reload_networks(const std::optional<std::string>& bigFile,
+                             const std::optional<std::string>& smallFile) {
+    const auto    start = std::chrono::steady_clock::now();
+    std::uint64_t read  = 0;
+
+    auto load = [&](auto& network, const std::string& file) {
+        const auto readStart = std::chrono::steady_clock::now();
+        network.load(binaryDirectory, file);
+        read += microseconds_since(readStart);
+    };
+
+    if (bigFile && networks.big)
+        networks.big->modify_and_replicate(
+          [&](NN::NetworkBig& network) { load(network, *bigFile); });
+    if (smallFile)
+        networks.small.modify_and_replicate(
+          [&](NN::NetworkSmall& network) { load(network, *smallFile); });
+
+    startupStats.networkLoads++;
+    startupStats.networkRead += read;
+    startupStats.networkShare += microseconds_since(start) - read;
+
+    const auto replicated = std::chrono::steady_clock::now();
     threads.clear();
     threads.ensure_network_replicated();
+    networksId = ++lastNetworksId;
+
+    startupStats.threadsReset += microseconds_since(replicated);
 }
 
 void Engine::load_big_network(const std::string& file) {
-    networks.modify_and_replicate(
-      [this, &file](NN::Networks& networks_) { networks_.big.load(binaryDirectory, file); });
-    threads.clear();
-    threads.ensure_network_replicated();
+    // In low memory mode, or before the big network is needed, the file is
+    // only read later
+    if (networks.big)
+        reload_networks(file, std::nullopt);
 }
 
-void Engine::load_small_network(const std::string& file) {
-    networks.modify_and_replicate(
-      [this, &file](NN::Networks& networks_) { networks_.small.load(binaryDirectory, file); });
-    threads.clear();
-    threads.ensure_network_replicated();
+void Engine::load_small_network(const std::string& file) { reload_networks(std::nullopt, file); }
+
+void Engine::load_deferred_networks() {
+    // Evaluations may come from other threads than the searches
+    std::lock_guard<std::mutex> lk(deferredLoadMutex);
+
+    if (!options["LowMemory"])
+        set_low_memory(false);
+}
+
+void Engine::set_low_memory(bool on) {
+    if (on == !networks.big)
+        return;
+
+    networks.set_big(!on);
+    reload_networks(on ? std::nullopt : std::optional<std::string>(options["EvalFile"]),
+                    std::nullopt);
 }
 
-void Engine::save_network(const std::pair<std::optional<std::string>, std::string> files[2]) {
-    networks.modify_and_replicate([&files](NN::Networks& networks_) {
-        networks_.big.save(files[0].first);
-        networks_.small.save(files[1].first);
-    });
+void Engine::save_network(const std::pair<std::optional<std::string>, std::string> files[2],
+                          bool                                                     image) {
+    load_deferred_networks();
+
+    if (networks.big)
+        (*networks.big)->save(files[0].first, image);
+    networks.small->save(files[1].first, image);
 }
 
 // utility functions
 
-void Engine::trace_eval() const {
+void Engine::trace_eval() {
     StateListPtr trace_states(new std::deque<StateInfo>(1));
     Position     p;
     p.set(pos.fen(), options["UCI_Chess960"], &trace_states->back());
 
+    load_deferred_networks();
     verify_networks();
 
     sync_cout << "\n" << Eval::trace(p, *networks) << sync_endl;
 }
 
+std::optional<std::vector<Engine::StaticEval>>
+Engine::evaluate_positions(const std::vector<std::string>& fens) {
+    load_deferred_networks();
+
+    // Unlike verify_networks(), which exits, a missing network is reported
+    if ((networks.big && !(*networks.big)->is_loaded(options["EvalFile"]))
+        || !networks.small->is_loaded(options["EvalFileSmall"]))
+        return std::nullopt;
+
+    EvalScratch& scratch = evalScratch;
+    if (scratch.networksId != networksId)
+    {
+        if (!scratch.accumulators)
+            scratch.accumulators = std::make_unique<NN::AccumulatorStack>();
+        scratch.accumulators->set_big_network(networks.big != nullptr);
+        scratch.caches     = std::make_unique<NN::AccumulatorCaches>(*networks);
+        scratch.networksId = networksId;
+    }
+
+    std::vector<StaticEval> results;
+    results.reserve(fens.size());
+
+    const bool chess960 = options["UCI_Chess960"];
+
+    StateInfo st;
+    Position  p;
+
+    for (const auto& fen : fens)
+    {
+        StaticEval r{false, false, VALUE_NONE, 0};
+
+        if (p.set_legal(fen, chess960, &st) && !p.checkers())
+        {
+            scratch.accumulators->reset();
+            r.value = Eval::evaluate(*networks, p, *scratch.accumulators, *scratch.caches,
+                                     VALUE_ZERO, &r.smallNet);
+            r.cp    = UCIEngine::to_cp(r.value, p);
+            r.valid = true;
+        }
+
+        results.push_back(r);
+    }
+
+    return results;
+}
+
 const OptionsMap& Engine::get_options() const { return options; }
 OptionsMap&       Engine::get_options() { return options; }
 
 std::string Engine::fen() const { return pos.fen(); }
 
-void Engine::flip() { pos.flip(); }
+void Engine::flip() {
+    pos.flip();
+    positionFen.clear();  // The next position is set up from scratch
+}
 
 std::string Engine::visualize() const {
     std::stringstream ss;
@@ -351,6 +693,45 @@ std::string Engine::visualize() const {
 
 int Engine::get_hashfull(int maxAge) const { return tt.hashfull(maxAge); }
 
+TTStats Engine::get_tt_stats([[maybe_unused]] bool reset) {
+    TTStats s = tt.stats();
+
+#ifdef TT_STATS
+    for (auto&& th : threads)
+    {
+        s.add(th->worker->ttCounters);
+
+        if (reset)
+            th->worker->ttCounters.reset();
+    }
+#endif
+
+    return s;
+}
+
+Search::PonderStats Engine::get_ponder_stats(bool reset) {
+    threads.end_background();  // It updates the counters when it stops
+
+    auto&                     stats = threads.main_manager()->ponderStats;
+    const Search::PonderStats s     = stats;
+
+    if (reset)
+        stats = {};
+
+    return s;
+}
+
+Engine::StartupStats Engine::get_startup_stats() const { return startupStats; }
+
+std::size_t Engine::big_network_memory() const {
+    using BigCache = NN::AccumulatorCaches::Cache<NN::TransformedFeatureDimensionsBig>;
+
+    const std::size_t perThread = sizeof(BigCache) + NN::AccumulatorStack::big_network_size();
+
+    return numaContext.get_numa_config().num_numa_nodes() * sizeof(NN::NetworkBig)
+         + threads.size() * perThread;
+}
+
 std::vector<std::pair<size_t, size_t>> Engine::get_bound_thread_count_by_numa_node() const {
     auto                                   counts = threads.get_bound_thread_count_by_numa_node();
     const NumaConfig&                      cfg    = numaContext.get_numa_config();
@@ -19,10 +19,12 @@
 #ifndef ENGINE_H_INCLUDED
 #define ENGINE_H_INCLUDED
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -47,6 +49,23 @@ class Engine {
     using InfoFull  = Search::InfoFull;
     using InfoIter  = Search::InfoIteration;
 
+    // Static evaluation of a position, from the point of view of the side to move
+    struct StaticEval {
+        bool  valid;     // false for illegal positions and positions in check
+        bool  smallNet;  // whether the small net produced the final score
+        Value value;
+        int   cp;
+    };
+
+    // Time spent starting the engine and loading the networks, in microseconds
+    struct StartupStats {
+        std::uint64_t created      = 0;  // constructing the engine, the first load included
+        std::uint64_t networkLoads = 0;  // of both networks at creation, then of either
+        std::uint64_t networkRead  = 0;  // reading and decoding the files
+        std::uint64_t networkShare = 0;  // copying, identifying and replicating them
+        std::uint64_t threadsReset = 0;  // clearing the threads and their network replicas
+    };
+
     Engine(std::optional<std::string> path = std::nullopt);
 
     // Cannot be movable due to components holding backreferences to fields
@@ -61,8 +80,16 @@ class Engine {
 
     // non blocking call to start searching
     void go(Search::LimitsType&);
+    // non blocking call to search the items independently, one per thread. The
+    // results are reported in the order of the items or as they complete.
+    void start_batch(std::vector<Search::BatchItem>,
+                     bool inItemOrder,
+                     std::function<void(const Search::BatchResult&)>,
+                     std::function<void()> onDone);
     // non blocking call to stop searching
     void stop();
+    // non blocking call to stop searching once the current iteration is complete
+    void stop_after_iteration();
 
     // blocking call to wait for search to finish
     void wait_for_search_finished();
@@ -74,31 +101,79 @@ class Engine {
     void set_numa_config_from_option(const std::string& o);
     void resize_threads();
     void set_tt_size(size_t mb);
+    // changes the size of the transposition table keeping its entries
+    TTMigration migrate_tt(size_t mb);
+    // gives every search thread a cache of the transposition table of its
+    // own, allocated on that thread, or none with kb 0
+    void set_tt_cache_size(size_t kb);
+    // spreads the pages of the transposition table over the NUMA nodes, which
+    // allocates it again
+    void set_tt_placement(TTPlacement p);
     void set_ponderhit(bool);
     void search_clear();
+    // clears the thread histories but keeps the transposition table
+    void clear_histories();
+    // writes the transposition table to a file, only the entries at most maxAge
+    // searches old unless maxAge is negative
+    bool save_hash(const std::string& path, int maxAge);
+    // replaces the transposition table with a saved one of the same size; a
+    // file of another size is rejected (WrongSize) and the table left as it is
+    TTFileStatus load_hash(const std::string& path);
+    // gives a named part of the transposition table its own clusters, or
+    // releases it with mb 0; searches use the part selected last, the common
+    // part if the name is unknown
+    bool set_tt_partition(const std::string& name, size_t mb);
+    void clear_tt_partition(const std::string& name);
+    void select_tt_partition(const std::string& name);
 
     void set_on_update_no_moves(std::function<void(const InfoShort&)>&&);
     void set_on_update_full(std::function<void(const InfoFull&)>&&);
     void set_on_iter(std::function<void(const InfoIter&)>&&);
     void set_on_bestmove(std::function<void(std::string_view, std::string_view)>&&);
     void set_on_verify_networks(std::function<void(std::string_view)>&&);
+    // whether InfoFull carries the formatted pv and wdl strings, or only raw data
+    void set_info_formatting(bool);
 
     // network related
 
     void verify_networks() const;
-    void load_networks();
+    // reads the big network if it was only left out until needed, which
+    // searching, evaluating and isready do, unless LowMemory is set by then
+    void load_deferred_networks();
     void load_big_network(const std::string& file);
     void load_small_network(const std::string& file);
-    void save_network(const std::pair<std::optional<std::string>, std::string> files[2]);
+    // frees the big network, its accumulators and refresh caches, so that
+    // every position is evaluated by the small one, or loads it back
+    void set_low_memory(bool on);
+    // saves the networks in the .nnue format, or as images of their parameters
+    // in memory, which load faster but only into builds of the same layout
+    void save_network(const std::pair<std::optional<std::string>, std::string> files[2],
+                      bool                                                     image = false);
 
     // utility functions
 
-    void trace_eval() const;
+    void trace_eval();
+    // evaluates each FEN with the static evaluation used by the search. The
+    // accumulator stack and refresh caches are kept per calling thread, so
+    // consecutive similar positions are cheap. Must not run concurrently with
+    // a network reload. Returns nothing if the networks set by the options are
+    // not loaded.
+    std::optional<std::vector<StaticEval>> evaluate_positions(const std::vector<std::string>& fens);
 
     const OptionsMap& get_options() const;
     OptionsMap&       get_options();
 
     int get_hashfull(int maxAge = 0) const;
+    // histograms of the transposition table entries and, in builds with
+    // TT_STATS, the probe and write counters of all threads, reset if asked
+    TTStats get_tt_stats(bool reset = false);
+    // outcome of the ponder searches split over several replies (PonderCandidates),
+    // reset if asked. Not to be called during a search.
+    Search::PonderStats get_ponder_stats(bool reset = false);
+    StartupStats        get_startup_stats() const;
+    // bytes taken by the big network, its accumulators and refresh caches, or
+    // left out by not loading it (LowMemory)
+    std::size_t big_network_memory() const;
 
     std::string                            fen() const;
     void                                   flip();
@@ -110,17 +185,35 @@ class Engine {
     std::string                            thread_binding_information_as_string() const;
 
    private:
+    // loads either network or both, and replicates them
+    void reload_networks(const std::optional<std::string>& bigFile,
+                         const std::optional<std::string>& smallFile);
+
+    // First member, so that StartupStats::created covers the others
+    const std::chrono::steady_clock::time_point constructionStart =
+      std::chrono::steady_clock::now();
+
     const std::string binaryDirectory;
 
     NumaReplicationContext numaContext;
 
-    Position     pos;
-    StateListPtr states;
-
-    OptionsMap                                         options;
-    ThreadPool                                         threads;
-    TranspositionTable                                 tt;
-    LazyNumaReplicatedSystemWide<Eval::NNUE::Networks> networks;
+    struct PlayedMove {
+        std::string uci;  // As given to set_position()
+        Move        move;
+    };
+
+    Position                pos;
+    StateListPtr            states;
+    std::string             positionFen;    // Of the position set last
+    std::vector<PlayedMove> positionMoves;  // Played from there to pos
+
+    OptionsMap                     options;
+    ThreadPool                     threads;
+    TranspositionTable             tt;
+    Eval::NNUE::ReplicatedNetworks networks;
+    std::uint64_t                  networksId = 0;
+    std::mutex                     deferredLoadMutex;
+    StartupStats                   startupStats;
 
     Search::SearchManager::UpdateContext  updateContext;
     std::function<void(std::string_view)> onVerifyNetworks;
@@ -49,29 +49,34 @@ int Eval::simple_eval(const Position& pos) {
 bool Eval::use_smallnet(const Position& pos) { return std::abs(simple_eval(pos)) > 962; }
 
 // Evaluate is the evaluator for the outer world. It returns a static evaluation
-// of the position from the point of view of the side to move.
+// of the position from the point of view of the side to move. If smallNetUsed
+// is given, it is set to whether the small net produced the final score.
 Value Eval::evaluate(const Eval::NNUE::Networks&    networks,
                      const Position&                pos,
                      Eval::NNUE::AccumulatorStack&  accumulators,
                      Eval::NNUE::AccumulatorCaches& caches,
-                     int                            optimism) {
+                     int                            optimism,
+                     bool*                          smallNetUsed) {
 
     assert(!pos.checkers());
 
-    bool smallNet           = use_smallnet(pos);
-    auto [psqt, positional] = smallNet ? networks.small.evaluate(pos, accumulators, caches.small)
-                                       : networks.big.evaluate(pos, accumulators, caches.big);
+    bool smallNet           = !networks.big || use_smallnet(pos);
+    auto [psqt, positional] = smallNet ? networks.small->evaluate(pos, accumulators, caches.small)
+                                       : networks.big->evaluate(pos, accumulators, *caches.big);
 
     Value nnue = (125 * psqt + 131 * positional) / 128;
 
     // Re-evaluate the position when higher eval accuracy is worth the time spent
-    if (smallNet && (std::abs(nnue) < 277))
+    if (smallNet && networks.big && (std::abs(nnue) < 277))
     {
-        std::tie(psqt, positional) = networks.big.evaluate(pos, accumulators, caches.big);
+        std::tie(psqt, positional) = networks.big->evaluate(pos, accumulators, *caches.big);
         nnue                       = (125 * psqt + 131 * positional) / 128;
         smallNet                   = false;
     }
 
+    if (smallNetUsed)
+        *smallNetUsed = smallNet;
+
     // Blend optimism and eval with nnue complexity
     int nnueComplexity = std::abs(psqt - positional);
     optimism += optimism * nnueComplexity / 476;
@@ -98,7 +103,7 @@ std::string Eval::trace(Position& pos, const Eval::NNUE::Networks& networks) {
     if (pos.checkers())
         return "Final evaluation: none (in check)";
 
-    auto accumulators = std::make_unique<Eval::NNUE::AccumulatorStack>();
+    auto accumulators = std::make_unique<Eval::NNUE::AccumulatorStack>(networks.big != nullptr);
     auto caches       = std::make_unique<Eval::NNUE::AccumulatorCaches>(networks);
 
     std::stringstream ss;
@@ -107,7 +112,9 @@ std::string Eval::trace(Position& pos, const Eval::NNUE::Networks& networks) {
 
     ss << std::showpoint << std::showpos << std::fixed << std::setprecision(2) << std::setw(15);
 
-    auto [psqt, positional] = networks.big.evaluate(pos, *accumulators, caches->big);
+    auto [psqt, positional] = networks.big
+                              ? networks.big->evaluate(pos, *accumulators, *caches->big)
+                              : networks.small->evaluate(pos, *accumulators, caches->small);
     Value v                 = psqt + positional;
     v                       = pos.side_to_move() == WHITE ? v : -v;
     ss << "NNUE evaluation        " << 0.01 * UCIEngine::to_cp(v, pos) << " (white side)\n";
@@ -50,7 +50,8 @@ Value evaluate(const NNUE::Networks&          networks,
                const Position&                pos,
                Eval::NNUE::AccumulatorStack&  accumulators,
                Eval::NNUE::AccumulatorCaches& caches,
-               int                            optimism);
+               int                            optimism,
+               bool*                          smallNetUsed = nullptr);
 }  // namespace Eval
 
 }  // namespace Stockfish
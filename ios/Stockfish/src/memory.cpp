@@ -35,6 +35,13 @@
     #include <stdlib.h>
 #endif
 
+#if defined(__APPLE__)
+    #include <mach/mach.h>
+#elif defined(__linux__)
+    #include <fstream>
+    #include <unistd.h>
+#endif
+
 #ifdef _WIN32
     #if _WIN32_WINNT < 0x0601
         #undef _WIN32_WINNT
@@ -49,6 +56,7 @@
     #include <iostream>  // std::cerr
     #include <ostream>   // std::endl
     #include <windows.h>
+    #include <psapi.h>
 
 // The needed Windows API for processor groups could be missed from old Windows
 // versions, so instead of calling them directly (forcing the linker to resolve
@@ -175,6 +183,40 @@ bool has_large_pages() {
 }
 
 
+size_t memory_usage() {
+
+#if defined(_WIN32)
+
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.WorkingSetSize;
+
+#elif defined(__APPLE__)
+
+    task_vm_info_data_t    info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, task_info_t(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return size_t(info.phys_footprint);
+
+#elif defined(__linux__)
+
+    // The second field is the resident set, in pages
+    std::ifstream statm("/proc/self/statm");
+    size_t        pages = 0, resident = 0;
+    if (!(statm >> pages >> resident))
+        return 0;
+    return resident * size_t(sysconf(_SC_PAGESIZE));
+
+#else
+
+    return 0;
+
+#endif
+}
+
+
 // aligned_large_pages_free() will free the previously memory allocated
 // by aligned_large_pages_alloc(). The effect is a nop if mem == nullptr.
 
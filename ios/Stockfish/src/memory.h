@@ -70,6 +70,10 @@ void  aligned_large_pages_free(void* mem);
 
 bool has_large_pages();
 
+// Memory the process currently keeps resident, in bytes, or 0 where it is
+// unknown. On Apple platforms, the footprint the system limits apps by.
+size_t memory_usage();
+
 // Frees memory which was placed there with placement new.
 // Works for both single objects and arrays of unknown bound.
 template<typename T, typename FREE_FUNC>
@@ -162,6 +162,24 @@ std::string engine_info(bool to_uci) {
 }
 
 
+// Returns the architecture the engine was compiled for, the one selected
+// for this CPU when several are built (see FlutterStockfish/dispatch.cpp)
+std::string compiler_arch() {
+
+#if defined(ARCH)
+    std::string arch = stringify(ARCH);
+#else
+    std::string arch = "(undefined architecture)";
+#endif
+
+#if defined(STOCKFISH_ARCH_DISPATCH)
+    arch += ", selected at run time";
+#endif
+
+    return arch;
+}
+
+
 // Returns a string trying to describe the compiler we use
 std::string compiler_info() {
 
@@ -228,12 +246,7 @@ std::string compiler_info() {
     compiler += " on unknown system";
 #endif
 
-    compiler += "\nCompilation architecture   : ";
-#if defined(ARCH)
-    compiler += stringify(ARCH);
-#else
-    compiler += "(undefined architecture)";
-#endif
+    compiler += "\nCompilation architecture   : " + compiler_arch();
 
     compiler += "\nCompilation settings       : ";
     compiler += (Is64Bit ? "64bit" : "32bit");
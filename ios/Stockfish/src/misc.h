@@ -44,6 +44,7 @@ namespace Stockfish {
 
 std::string engine_version_info();
 std::string engine_info(bool to_uci = false);
+std::string compiler_arch();
 std::string compiler_info();
 
 // Preloads the given address in L1/L2 cache. This is a non-blocking
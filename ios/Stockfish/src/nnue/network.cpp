@@ -19,9 +19,11 @@
 #include "network.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <optional>
+#include <sys/stat.h>
 #include <type_traits>
 #include <vector>
 
@@ -43,7 +45,12 @@
 //     const unsigned char *const gEmbeddedNNUEEnd;     // a marker to the end
 //     const unsigned int         gEmbeddedNNUESize;    // the size of the embedded file
 // Note that this does not work in Microsoft Visual Studio.
-#if !defined(_MSC_VER) && !defined(NNUE_EMBEDDING_OFF)
+#if !defined(_MSC_VER) && !defined(NNUE_EMBEDDING_OFF) && defined(NNUE_EMBEDDING_EXTERN)
+// Built once per architecture, the data is embedded in the library that
+// loads this one (see FlutterStockfish/dispatch.cpp)
+INCBIN_EXTERN(EmbeddedNNUEBig);
+INCBIN_EXTERN(EmbeddedNNUESmall);
+#elif !defined(_MSC_VER) && !defined(NNUE_EMBEDDING_OFF)
 INCBIN(EmbeddedNNUEBig, EvalFileDefaultNameBig);
 INCBIN(EmbeddedNNUESmall, EvalFileDefaultNameSmall);
 #else
@@ -78,6 +85,108 @@ EmbeddedNNUE get_embedded(EmbeddedNNUEType type) {
         return EmbeddedNNUE(gEmbeddedNNUESmallData, gEmbeddedNNUESmallEnd, gEmbeddedNNUESmallSize);
 }
 
+// Header of a network image, written by 'export_net image'. An image holds
+// the parameters as they are in memory, permuted and scaled for the SIMD
+// instructions of the build, so loading it is a single read. It only loads
+// into a build with the same layout, and the same byte order.
+struct ImageHeader {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint32_t layout;
+    std::uint32_t hash;  // Of the network structure
+    std::uint64_t transformerSize;
+    std::uint64_t layerStacksSize;
+    std::uint32_t descriptionSize;
+    std::uint32_t dataOffset;  // Of the parameters, cache line aligned
+};
+
+constexpr char          ImageMagic[8]  = {'S', 'F', 'N', 'N', 'U', 'E', 'I', 'M'};
+constexpr std::uint32_t ImageVersion   = 1;
+constexpr std::uint32_t ImageByteOrder = 0x01020304;
+
+// The instruction sets that change the order of the weights in memory
+constexpr std::uint32_t ImageLayout = []() {
+    std::uint32_t layout = 0;
+#if defined(USE_AVX512)
+    layout |= 1;  // Feature transformer blocks, see PackusEpi16Order
+#elif defined(USE_AVX2)
+    layout |= 2;
+#endif
+#if defined(USE_SSSE3) || defined(USE_NEON_DOTPROD)
+    layout |= 4;  // Dense affine layers, see AffineTransform::get_weight_index()
+#endif
+#if (USE_SSSE3 | (USE_NEON >= 8))
+    layout |= 8;  // Sparse input layer
+#endif
+    return layout;
+}();
+
+ImageHeader image_header(std::uint32_t hash,
+                         std::size_t   transformerSize,
+                         std::size_t   layerStacksSize,
+                         std::size_t   descriptionSize) {
+    ImageHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, ImageMagic, sizeof(h.magic));
+    h.version         = ImageVersion;
+    h.byteOrder       = ImageByteOrder;
+    h.layout          = ImageLayout;
+    h.hash            = hash;
+    h.transformerSize = transformerSize;
+    h.layerStacksSize = layerStacksSize;
+    h.descriptionSize = std::uint32_t(descriptionSize);
+    h.dataOffset =
+      std::uint32_t(ceil_to_multiple<std::size_t>(sizeof(h) + descriptionSize, CacheLineSize));
+    return h;
+}
+
+// The embedded networks, known by their names, which start with their SHA-256
+constexpr std::uint64_t EmbeddedDigest = []() {
+    std::uint64_t h = 14695981039346656037ull;  // FNV-1a
+    for (const char* p : {EvalFileDefaultNameBig, EvalFileDefaultNameSmall})
+        for (; *p; ++p)
+            h = (h ^ std::uint8_t(*p)) * 1099511628211ull;
+    return h;
+}();
+
+// Identifies parameters in memory without hashing them: along with their
+// source, the structure of the network, the embedded networks of the build
+// and the layout and format they were transformed to. ImageVersion must change
+// with the transformation, so that builds of other code do not share them.
+std::size_t parameters_key(std::uint32_t hash, std::size_t source) {
+    std::size_t h = source;
+    Stockfish::hash_combine(h, hash);
+    Stockfish::hash_combine(h, ImageLayout);
+    Stockfish::hash_combine(h, ImageVersion);
+    Stockfish::hash_combine(h, EmbeddedDigest);
+    return h;
+}
+
+// A network file is known by its device, inode, size and modification time,
+// none of which Windows has reliably, so there it is hashed in full
+std::optional<std::size_t> file_key([[maybe_unused]] const std::string& path) {
+#if defined(_WIN32)
+    return std::nullopt;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st))
+        return std::nullopt;
+
+    std::size_t h = 0;
+    Stockfish::hash_combine(h, std::uint64_t(st.st_dev));
+    Stockfish::hash_combine(h, std::uint64_t(st.st_ino));
+    Stockfish::hash_combine(h, std::uint64_t(st.st_size));
+    Stockfish::hash_combine(h, std::uint64_t(st.st_mtime));
+    #if defined(__APPLE__)
+    Stockfish::hash_combine(h, std::uint64_t(st.st_mtimespec.tv_nsec));
+    #else
+    Stockfish::hash_combine(h, std::uint64_t(st.st_mtim.tv_nsec));
+    #endif
+    return h;
+#endif
+}
+
 }
 
 
@@ -134,11 +243,16 @@ void Network<Arch, Transformer>::load(const std::string& rootDirectory, std::str
             }
         }
     }
+
+    // The parameters may have been overwritten in part by a failed load
+    if (std::string(evalFile.current) != evalfilePath)
+        parametersHash = hash_parameters();
 }
 
 
 template<typename Arch, typename Transformer>
-bool Network<Arch, Transformer>::save(const std::optional<std::string>& filename) const {
+bool Network<Arch, Transformer>::save(const std::optional<std::string>& filename,
+                                      bool                              image) const {
     std::string actualFilename;
     std::string msg;
 
@@ -159,7 +273,7 @@ bool Network<Arch, Transformer>::save(const std::optional<std::string>& filename
     }
 
     std::ofstream stream(actualFilename, std::ios_base::binary);
-    bool          saved = save(stream, evalFile.current, evalFile.netDescription);
+    bool          saved = save(stream, evalFile.current, evalFile.netDescription, image);
 
     msg = saved ? "Network saved successfully to " + actualFilename : "Failed to export a net";
 
@@ -189,13 +303,22 @@ Network<Arch, Transformer>::evaluate(const Position&                         pos
 }
 
 
+template<typename Arch, typename Transformer>
+bool Network<Arch, Transformer>::is_loaded(std::string evalfilePath) const {
+    if (evalfilePath.empty())
+        evalfilePath = evalFile.defaultName;
+
+    return std::string(evalFile.current) == evalfilePath;
+}
+
+
 template<typename Arch, typename Transformer>
 void Network<Arch, Transformer>::verify(std::string                                  evalfilePath,
                                         const std::function<void(std::string_view)>& f) const {
     if (evalfilePath.empty())
         evalfilePath = evalFile.defaultName;
 
-    if (std::string(evalFile.current) != evalfilePath)
+    if (!is_loaded(evalfilePath))
     {
         if (f)
         {
@@ -269,6 +392,9 @@ void Network<Arch, Transformer>::load_user_net(const std::string& dir,
     {
         evalFile.current        = evalfilePath;
         evalFile.netDescription = description.value();
+
+        const auto key = file_key(dir + evalfilePath);
+        parametersHash = key ? parameters_key(Network::hash, *key) : hash_parameters();
     }
 }
 
@@ -282,6 +408,23 @@ void Network<Arch, Transformer>::load_internal() {
             setg(p, p, p + n);
             setp(p, p + n);
         }
+
+       protected:
+        // Needed by load() to rewind when the network is not an image
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) override {
+            char* base = dir == std::ios_base::beg ? eback()
+                       : dir == std::ios_base::cur ? gptr()
+                                                   : egptr();
+            if (off < eback() - base || off > egptr() - base)
+                return pos_type(off_type(-1));
+
+            setg(eback(), base + off, egptr());
+            return pos_type(gptr() - eback());
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
     };
 
     const auto embedded = get_embedded(embeddedType);
@@ -296,6 +439,9 @@ void Network<Arch, Transformer>::load_internal() {
     {
         evalFile.current        = evalFile.defaultName;
         evalFile.netDescription = description.value();
+
+        // Named after the start of their SHA-256, which evalFile adds
+        parametersHash = parameters_key(Network::hash, 0);
     }
 }
 
@@ -309,11 +455,12 @@ void Network<Arch, Transformer>::initialize() {
 template<typename Arch, typename Transformer>
 bool Network<Arch, Transformer>::save(std::ostream&      stream,
                                       const std::string& name,
-                                      const std::string& netDescription) const {
+                                      const std::string& netDescription,
+                                      bool               image) const {
     if (name.empty() || name == "None")
         return false;
 
-    return write_parameters(stream, netDescription);
+    return image ? write_image(stream, netDescription) : write_parameters(stream, netDescription);
 }
 
 
@@ -322,6 +469,13 @@ std::optional<std::string> Network<Arch, Transformer>::load(std::istream& stream
     initialize();
     std::string description;
 
+    const auto start = stream.tellg();
+    if (read_image(stream, description))
+        return description;
+
+    stream.clear();
+    stream.seekg(start);
+
     return read_parameters(stream, description) ? std::make_optional(description) : std::nullopt;
 }
 
@@ -331,12 +485,19 @@ std::size_t Network<Arch, Transformer>::get_content_hash() const {
     if (!initialized)
         return 0;
 
+    std::size_t h = parametersHash;
+    hash_combine(h, evalFile);
+    hash_combine(h, static_cast<int>(embeddedType));
+    return h;
+}
+
+
+template<typename Arch, typename Transformer>
+std::size_t Network<Arch, Transformer>::hash_parameters() const {
     std::size_t h = 0;
     hash_combine(h, featureTransformer);
     for (auto&& layerstack : network)
         hash_combine(h, layerstack);
-    hash_combine(h, evalFile);
-    hash_combine(h, static_cast<int>(embeddedType));
     return h;
 }
 
@@ -405,6 +566,50 @@ bool Network<Arch, Transformer>::write_parameters(std::ostream&      stream,
     return bool(stream);
 }
 
+
+template<typename Arch, typename Transformer>
+bool Network<Arch, Transformer>::read_image(std::istream& stream, std::string& netDescription) {
+    static_assert(std::is_trivially_copyable_v<Transformer>
+                  && std::is_trivially_copyable_v<Arch>);
+
+    ImageHeader header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+
+    const ImageHeader expected = image_header(Network::hash, sizeof(featureTransformer),
+                                              sizeof(network), header.descriptionSize);
+
+    if (std::memcmp(&header, &expected, sizeof(header)))
+        return false;
+
+    // The parameters are read straight into place, without an intermediate
+    // copy of the file, so that loading needs no more memory than the network.
+    netDescription.resize(header.descriptionSize);
+    stream.read(netDescription.data(), header.descriptionSize);
+    stream.ignore(header.dataOffset - sizeof(header) - header.descriptionSize);
+    stream.read(reinterpret_cast<char*>(&featureTransformer), sizeof(featureTransformer));
+    stream.read(reinterpret_cast<char*>(network), sizeof(network));
+
+    return stream && stream.peek() == std::ios::traits_type::eof();
+}
+
+
+template<typename Arch, typename Transformer>
+bool Network<Arch, Transformer>::write_image(std::ostream&      stream,
+                                             const std::string& netDescription) const {
+    const ImageHeader header = image_header(Network::hash, sizeof(featureTransformer),
+                                            sizeof(network), netDescription.size());
+
+    const std::string padding(header.dataOffset - sizeof(header) - netDescription.size(), '\0');
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(netDescription.data(), netDescription.size());
+    stream.write(padding.data(), padding.size());
+    stream.write(reinterpret_cast<const char*>(&featureTransformer), sizeof(featureTransformer));
+    stream.write(reinterpret_cast<const char*>(network), sizeof(network));
+    return bool(stream);
+}
+
 // Explicit template instantiations
 
 template class Network<NetworkArchitecture<TransformedFeatureDimensionsBig, L2Big, L3Big>,
@@ -30,6 +30,7 @@
 #include <tuple>
 
 #include "../misc.h"
+#include "../numa.h"
 #include "../types.h"
 #include "nnue_accumulator.h"
 #include "nnue_architecture.h"
@@ -69,7 +70,7 @@ class Network {
     Network& operator=(Network&& other)      = default;
 
     void load(const std::string& rootDirectory, std::string evalfilePath);
-    bool save(const std::optional<std::string>& filename) const;
+    bool save(const std::optional<std::string>& filename, bool image = false) const;
 
     std::size_t get_content_hash() const;
 
@@ -77,7 +78,8 @@ class Network {
                            AccumulatorStack&                       accumulatorStack,
                            AccumulatorCaches::Cache<FTDimensions>& cache) const;
 
-
+    // Whether the network of the file, the default one if empty, is loaded
+    bool is_loaded(std::string evalfilePath) const;
     void verify(std::string evalfilePath, const std::function<void(std::string_view)>&) const;
     NnueEvalTrace trace_evaluate(const Position&                         pos,
                                  AccumulatorStack&                       accumulatorStack,
@@ -89,7 +91,11 @@ class Network {
 
     void initialize();
 
-    bool                       save(std::ostream&, const std::string&, const std::string&) const;
+    // Hashing the parameters takes longer than reading them, so they are
+    // identified by where they were loaded from unless that fails
+    std::size_t hash_parameters() const;
+
+    bool save(std::ostream&, const std::string&, const std::string&, bool image) const;
     std::optional<std::string> load(std::istream&);
 
     bool read_header(std::istream&, std::uint32_t*, std::string*) const;
@@ -98,6 +104,9 @@ class Network {
     bool read_parameters(std::istream&, std::string&);
     bool write_parameters(std::ostream&, const std::string&) const;
 
+    bool read_image(std::istream&, std::string&);
+    bool write_image(std::ostream&, const std::string&) const;
+
     // Input feature converter
     Transformer featureTransformer;
 
@@ -107,7 +116,8 @@ class Network {
     EvalFile         evalFile;
     EmbeddedNNUEType embeddedType;
 
-    bool initialized = false;
+    bool        initialized    = false;
+    std::size_t parametersHash = 0;
 
     // Hash value of evaluation function structure
     static constexpr std::uint32_t hash = Transformer::get_hash_value() ^ Arch::get_hash_value();
@@ -128,13 +138,51 @@ using NetworkBig   = Network<BigNetworkArchitecture, BigFeatureTransformer>;
 using NetworkSmall = Network<SmallNetworkArchitecture, SmallFeatureTransformer>;
 
 
+// The networks an evaluation uses, those of a NUMA node
 struct Networks {
-    Networks(EvalFile bigFile, EvalFile smallFile) :
-        big(bigFile, EmbeddedNNUEType::BIG),
-        small(smallFile, EmbeddedNNUEType::SMALL) {}
+    const NetworkBig*   big;  // None in low memory mode (LowMemory)
+    const NetworkSmall* small;
+};
+
+// The networks replicated on the NUMA nodes. Each has replicas of its own, so
+// that the engine can run without the big one, which is only created by set_big().
+class ReplicatedNetworks {
+   public:
+    ReplicatedNetworks(NumaReplicationContext& ctx, EvalFile bigFile, EvalFile smallFile) :
+        small(ctx, std::make_unique<NetworkSmall>(smallFile, EmbeddedNNUEType::SMALL)),
+        context(ctx),
+        bigFileDefault(bigFile) {}
+
+    Networks operator[](NumaReplicatedAccessToken token) const {
+        return {big ? &(*big)[token] : nullptr, &small[token]};
+    }
+
+    // Those of the first NUMA node
+    Networks operator*() const { return {big ? &**big : nullptr, &*small}; }
+
+    // Replicates an empty big network, to be loaded, or frees it
+    void set_big(bool present) {
+        if (!present)
+            big.reset();
+        else if (!big)
+            big = std::make_unique<LazyNumaReplicatedSystemWide<NetworkBig>>(
+              context, std::make_unique<NetworkBig>(bigFileDefault, EmbeddedNNUEType::BIG));
+    }
 
-    NetworkBig   big;
-    NetworkSmall small;
+    std::size_t get_content_hash() const {
+        std::size_t h = 0;
+        if (big)
+            hash_combine(h, (*big)->get_content_hash());
+        hash_combine(h, small->get_content_hash());
+        return h;
+    }
+
+    std::unique_ptr<LazyNumaReplicatedSystemWide<NetworkBig>> big;
+    LazyNumaReplicatedSystemWide<NetworkSmall>                small;
+
+   private:
+    NumaReplicationContext& context;
+    EvalFile                bigFileDefault;
 };
 
 
@@ -148,14 +196,4 @@ struct std::hash<Stockfish::Eval::NNUE::Network<ArchT, FeatureTransformerT>> {
     }
 };
 
-template<>
-struct std::hash<Stockfish::Eval::NNUE::Networks> {
-    std::size_t operator()(const Stockfish::Eval::NNUE::Networks& networks) const noexcept {
-        std::size_t h = 0;
-        Stockfish::hash_combine(h, networks.big);
-        Stockfish::hash_combine(h, networks.small);
-        return h;
-    }
-};
-
 #endif
@@ -102,7 +102,7 @@ AccumulatorStack::accumulators() const noexcept {
         return psq_accumulators;
 
     if constexpr (std::is_same_v<T, ThreatFeatureSet>)
-        return threat_accumulators;
+        return big->threatStates;
 }
 
 template<typename T>
@@ -115,19 +115,42 @@ AccumulatorStack::mut_accumulators() noexcept {
         return psq_accumulators;
 
     if constexpr (std::is_same_v<T, ThreatFeatureSet>)
-        return threat_accumulators;
+        return big->threatStates;
 }
 
+void AccumulatorStack::set_big_network(bool loaded) {
+    if (loaded && !big)
+    {
+        big = make_unique_aligned<BigNetworkStorage>();
+        for (std::size_t i = 0; i < MaxSize; ++i)
+        {
+            psq_accumulators[i].accumulatorBig   = &big->psq[i];
+            big->threatStates[i].accumulatorBig = &big->threat[i];
+        }
+    }
+    else if (!loaded && big)
+    {
+        big.reset();
+        for (auto& state : psq_accumulators)
+            state.accumulatorBig = nullptr;
+    }
+
+    reset();
+}
+
+std::size_t AccumulatorStack::big_network_size() noexcept { return sizeof(BigNetworkStorage); }
+
 void AccumulatorStack::reset() noexcept {
     psq_accumulators[0].reset({});
-    threat_accumulators[0].reset({});
+    if (big)
+        big->threatStates[0].reset({});
     size = 1;
 }
 
 std::pair<DirtyPiece&, DirtyThreats&> AccumulatorStack::push() noexcept {
     assert(size < MaxSize);
     auto& dp  = psq_accumulators[size].reset();
-    auto& dts = threat_accumulators[size].reset();
+    auto& dts = big ? big->threatStates[size].reset() : scratchThreats;
     new (&dts) DirtyThreats;
     size++;
     return {dp, dts};
@@ -27,6 +27,7 @@
 #include <cstring>
 #include <utility>
 
+#include "../memory.h"
 #include "../types.h"
 #include "nnue_architecture.h"
 #include "nnue_common.h"
@@ -97,18 +98,28 @@ struct AccumulatorCaches {
 
     template<typename Networks>
     void clear(const Networks& networks) {
-        big.clear(networks.big);
-        small.clear(networks.small);
+        if (networks.big)
+        {
+            if (!big)
+                big = make_unique_aligned<Cache<TransformedFeatureDimensionsBig>>();
+            big->clear(*networks.big);
+        }
+        else
+            big.reset();
+
+        small.clear(*networks.small);
     }
 
-    Cache<TransformedFeatureDimensionsBig>   big;
-    Cache<TransformedFeatureDimensionsSmall> small;
+    // None without the big network (LowMemory)
+    AlignedPtr<Cache<TransformedFeatureDimensionsBig>> big;
+    Cache<TransformedFeatureDimensionsSmall>           small;
 };
 
 
 template<typename FeatureSet>
 struct AccumulatorState {
-    Accumulator<TransformedFeatureDimensionsBig>   accumulatorBig;
+    // In the storage of the stack for the big network, if it has one
+    Accumulator<TransformedFeatureDimensionsBig>*  accumulatorBig = nullptr;
     Accumulator<TransformedFeatureDimensionsSmall> accumulatorSmall;
     typename FeatureSet::DiffType                  diff;
 
@@ -119,7 +130,7 @@ struct AccumulatorState {
                       "Invalid size for accumulator");
 
         if constexpr (Size == TransformedFeatureDimensionsBig)
-            return accumulatorBig;
+            return *accumulatorBig;
         else if constexpr (Size == TransformedFeatureDimensionsSmall)
             return accumulatorSmall;
     }
@@ -131,28 +142,45 @@ struct AccumulatorState {
                       "Invalid size for accumulator");
 
         if constexpr (Size == TransformedFeatureDimensionsBig)
-            return accumulatorBig;
+            return *accumulatorBig;
         else if constexpr (Size == TransformedFeatureDimensionsSmall)
             return accumulatorSmall;
     }
 
     void reset(const typename FeatureSet::DiffType& dp) noexcept {
         diff = dp;
-        accumulatorBig.computed.fill(false);
+        if (accumulatorBig)
+            accumulatorBig->computed.fill(false);
         accumulatorSmall.computed.fill(false);
     }
 
     typename FeatureSet::DiffType& reset() noexcept {
-        accumulatorBig.computed.fill(false);
+        if (accumulatorBig)
+            accumulatorBig->computed.fill(false);
         accumulatorSmall.computed.fill(false);
         return diff;
     }
 };
 
 class AccumulatorStack {
+    struct BigNetworkStorage;
+
    public:
     static constexpr std::size_t MaxSize = MAX_PLY + 1;
 
+    explicit AccumulatorStack(bool bigNetwork = true) { set_big_network(bigNetwork); }
+
+    // The states point into the storage
+    AccumulatorStack(const AccumulatorStack&)            = delete;
+    AccumulatorStack& operator=(const AccumulatorStack&) = delete;
+
+    // Allocates the accumulators of the big network and the states of its
+    // threat features, or frees them when it is not loaded (LowMemory). Also
+    // resets the stack.
+    void set_big_network(bool loaded);
+
+    static std::size_t big_network_size() noexcept;
+
     template<typename T>
     [[nodiscard]] const AccumulatorState<T>& latest() const noexcept;
 
@@ -196,9 +224,16 @@ class AccumulatorStack {
                                      const FeatureTransformer<Dimensions>& featureTransformer,
                                      const std::size_t                     end) noexcept;
 
-    std::array<AccumulatorState<PSQFeatureSet>, MaxSize>    psq_accumulators;
-    std::array<AccumulatorState<ThreatFeatureSet>, MaxSize> threat_accumulators;
-    std::size_t                                             size = 1;
+    struct BigNetworkStorage {
+        std::array<Accumulator<TransformedFeatureDimensionsBig>, MaxSize> psq;
+        std::array<Accumulator<TransformedFeatureDimensionsBig>, MaxSize> threat;
+        std::array<AccumulatorState<ThreatFeatureSet>, MaxSize>           threatStates;
+    };
+
+    std::array<AccumulatorState<PSQFeatureSet>, MaxSize> psq_accumulators;
+    AlignedPtr<BigNetworkStorage>                        big;
+    DirtyThreats scratchThreats;  // Written by the moves and ignored, without the big network
+    std::size_t  size = 1;
 };
 
 }  // namespace Stockfish::Eval::NNUE
@@ -120,11 +120,17 @@ trace(Position& pos, const Eval::NNUE::Networks& networks, Eval::NNUE::Accumulat
             format_cp_compact(value, &board[y + 2][x + 2], pos);
     };
 
-    auto accumulators = std::make_unique<AccumulatorStack>();
+    auto accumulators = std::make_unique<AccumulatorStack>(networks.big != nullptr);
+
+    // Without the big network (LowMemory) the small one is traced instead
+    auto evaluate = [&]() {
+        return networks.big ? networks.big->evaluate(pos, *accumulators, *caches.big)
+                            : networks.small->evaluate(pos, *accumulators, caches.small);
+    };
 
     // We estimate the value of each piece by doing a differential evaluation from
     // the current base eval, simulating the removal of the piece from its square.
-    auto [psqt, positional] = networks.big.evaluate(pos, *accumulators, caches.big);
+    auto [psqt, positional] = evaluate();
     Value base              = psqt + positional;
     base                    = pos.side_to_move() == WHITE ? base : -base;
 
@@ -140,7 +146,7 @@ trace(Position& pos, const Eval::NNUE::Networks& networks, Eval::NNUE::Accumulat
                 pos.remove_piece(sq);
 
                 accumulators->reset();
-                std::tie(psqt, positional) = networks.big.evaluate(pos, *accumulators, caches.big);
+                std::tie(psqt, positional) = evaluate();
                 Value eval                 = psqt + positional;
                 eval                       = pos.side_to_move() == WHITE ? eval : -eval;
                 v                          = base - eval;
@@ -157,7 +163,8 @@ trace(Position& pos, const Eval::NNUE::Networks& networks, Eval::NNUE::Accumulat
     ss << '\n';
 
     accumulators->reset();
-    auto t = networks.big.trace_evaluate(pos, *accumulators, caches.big);
+    auto t = networks.big ? networks.big->trace_evaluate(pos, *accumulators, *caches.big)
+                          : networks.small->trace_evaluate(pos, *accumulators, caches.small);
 
     ss << " NNUE network contributions "
        << (pos.side_to_move() == WHITE ? "(White to move)" : "(Black to move)") << std::endl
@@ -299,6 +299,97 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
 }
 
 
+// Sets up the position like set(), but only if fenStr is a legal position:
+// set() trusts its input and writes out of bounds on a malformed board or a
+// castling right without its rook. The board must have 8 ranks of 8 squares,
+// one king and at most 16 pieces and 8 pawns per side, no pawn on the first
+// or last rank, and a rook for every castling right. The side that just
+// moved must not be in check. Returns false for anything else.
+bool Position::set_legal(const string& fenStr, bool isChess960, StateInfo* si) {
+
+    std::istringstream ss(fenStr);
+    string             placement, side, castling = "-";
+    ss >> placement >> side >> castling;
+
+    std::array<Piece, SQUARE_NB> squares{};
+    int                          pieceTotal[COLOR_NB]{}, pawnCount[COLOR_NB]{};
+    int                          kingCount[COLOR_NB]{};
+    int                          rank = RANK_8, file = FILE_A;
+    size_t                       idx;
+
+    for (char token : placement)
+        if (token == '/')
+        {
+            if (file != FILE_NB || rank == RANK_1)
+                return false;
+
+            --rank;
+            file = FILE_A;
+        }
+        else if (token >= '1' && token <= '8')
+        {
+            if ((file += token - '0') > FILE_NB)
+                return false;
+        }
+        else if (token != ' ' && (idx = PieceToChar.find(token)) != string::npos)
+        {
+            const Piece pc = Piece(idx);
+
+            if (file == FILE_NB
+                || (type_of(pc) == PAWN && (rank == RANK_1 || rank == RANK_8)))
+                return false;
+
+            squares[make_square(File(file++), Rank(rank))] = pc;
+            pieceTotal[color_of(pc)]++;
+            pawnCount[color_of(pc)] += type_of(pc) == PAWN;
+            kingCount[color_of(pc)] += type_of(pc) == KING;
+        }
+        else
+            return false;
+
+    if (rank != RANK_1 || file != FILE_NB || (side != "w" && side != "b"))
+        return false;
+
+    for (Color c : {WHITE, BLACK})
+        if (kingCount[c] != 1 || pieceTotal[c] > 16 || pawnCount[c] > 8)
+            return false;
+
+    // set() looks for the rook of a right along the first rank of its side
+    for (char token : castling == "-" ? string() : castling)
+    {
+        const Color c    = islower(token) ? BLACK : WHITE;
+        const Piece rook = make_piece(c, ROOK);
+        const auto  king = std::find(squares.begin(), squares.end(), make_piece(c, KING));
+        const Rank  r    = relative_rank(c, RANK_1);
+        const File  kf   = file_of(Square(king - squares.begin()));
+
+        token = char(toupper(token));
+
+        if (rank_of(Square(king - squares.begin())) != r)
+            return false;
+
+        bool found = false;
+
+        if (token == 'K')
+            for (File f = File(kf + 1); f <= FILE_H; ++f)
+                found |= squares[make_square(f, r)] == rook;
+
+        else if (token == 'Q')
+            for (File f = FILE_A; f < kf; ++f)
+                found |= squares[make_square(f, r)] == rook;
+
+        else if (token >= 'A' && token <= 'H')
+            found = squares[make_square(File(token - 'A'), r)] == rook;
+
+        if (!found)
+            return false;
+    }
+
+    set(fenStr, isChess960, si);
+
+    return !(attackers_to(square<KING>(~sideToMove)) & pieces(sideToMove));
+}
+
 // Helper function used to set castling
 // rights given the corresponding color and the rook starting square.
 void Position::set_castling_right(Color c, Square rfrom) {
@@ -31,6 +31,7 @@
 #include <list>
 #include <ratio>
 #include <string>
+#include <thread>
 #include <utility>
 
 #include "bitboard.h"
@@ -171,7 +172,14 @@ Search::Worker::Worker(SharedState&                    sharedState,
     tt(sharedState.tt),
     networks(sharedState.networks),
     refreshTable(networks[token]) {
+    stopSignal    = &threads.stop;
+    abortedSignal = &threads.abortedSearch;
     clear();
+
+    // Workers are constructed on their own thread
+#ifdef TT_STATS
+    TranspositionTable::count_on_this_thread(&ttCounters, token.get_numa_index());
+#endif
 }
 
 void Search::Worker::ensure_network_replicated() {
@@ -222,6 +230,28 @@ void Search::Worker::start_searching() {
     // Wait until all threads have finished
     threads.wait_for_search_finished();
 
+    // Keep the outcome of each reply searched while pondering for the next
+    // search. After a ponderhit, the expected reply has been played.
+    auto& speculation = main_manager()->speculation;
+
+    if (!speculation.roots.empty())
+    {
+        auto& stats = main_manager()->ponderStats;
+
+        if (main_manager()->ponder)
+            speculation.pondered = elapsed();
+
+        keep_speculative_roots();
+        stats.pondered += uint64_t(speculation.pondered) * threads.size();
+
+        if (!main_manager()->ponder)
+        {
+            ++stats.hits;
+            stats.hitTime += uint64_t(speculation.pondered) * speculation.roots[0].threads;
+            speculation = {};
+        }
+    }
+
     // When playing in 'nodes as time' mode, subtract the searched nodes from
     // the available ones before exiting.
     if (limits.npmsec)
@@ -249,8 +279,136 @@ void Search::Worker::start_searching() {
         || bestThread->rootMoves[0].extract_ponder_from_tt(tt, rootPos))
         ponder = UCIEngine::move(bestThread->rootMoves[0].pv[1], rootPos.is_chess960());
 
+    // Kept for the next search, with the keys of the positions the next root
+    // may be among, and the ponder move if it was found in the TT
+    auto& previous = main_manager()->previous;
+    previous       = {};
+
+    if (bestThread->rootMoves[0].pv[0] != Move::none())
+    {
+        previous.rootKey = rootPos.key();
+        previous.pv      = bestThread->rootMoves[0].pv;
+        previous.depth   = bestThread->completedDepth;
+        previous.score   = bestThread->rootMoves[0].score;
+
+        StateInfo    st[2];
+        const size_t n = std::min(previous.pv.size(), size_t(2));
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            rootPos.do_move(previous.pv[i], st[i], &tt);
+            previous.pvKeys[i] = rootPos.key();
+        }
+
+        for (size_t i = n; i > 0; --i)
+            rootPos.undo_move(previous.pv[i - 1]);
+    }
+
     auto bestmove = UCIEngine::move(bestThread->rootMoves[0].pv[0], rootPos.is_chess960());
     main_manager()->updates.onBestmove(bestmove, ponder);
+
+    // When asked for, search on after the expected reply until the next command
+    if (threads.begin_background())
+        threads.search_in_background();
+}
+
+// Keeps the deepest PV, score and depth found for each reply searched
+// speculatively, which the next search takes over if the reply is played
+void Search::Worker::keep_speculative_roots() {
+    auto& speculation = main_manager()->speculation;
+
+    for (auto&& th : threads)
+    {
+        const Worker& w    = *th->worker;
+        auto&         root = speculation.roots[w.rootIdx];
+
+        if (w.rootMoves[0].pv[0] != Move::none() && w.completedDepth > root.depth)
+        {
+            root.pv    = w.rootMoves[0].pv;
+            root.depth = w.completedDepth;
+            root.score = w.rootMoves[0].score;
+        }
+    }
+}
+
+int Search::SearchManager::PreviousSearch::plies_to(const Position& pos) const {
+    const StateInfo* st = pos.state();
+
+    for (int plies = 1; plies <= 2 && plies < int(pv.size()); ++plies)
+    {
+        if (!(st = st->previous))
+            break;
+
+        if (st->key == rootKey && pos.key() == pvKeys[plies - 1])
+            return plies;
+    }
+
+    return 0;
+}
+
+int Search::SearchManager::Speculation::find(const Position& pos) const {
+    const StateInfo* st = pos.state()->previous;
+
+    if (!st || st->key != parentKey)
+        return -1;
+
+    for (size_t i = 0; i < roots.size(); ++i)
+        if (roots[i].key == pos.key())
+            return int(i);
+
+    return -1;
+}
+
+// Searches one position on this thread only, while the other threads of the
+// pool do the same with their own positions. The limits are checked by the
+// worker itself instead of the SearchManager, and nothing is reported until
+// the search is over.
+Search::BatchResult Search::Worker::search_alone(const BatchItem& item) {
+
+    rootPos.set(item.fen, options["UCI_Chess960"], &rootState);
+
+    limits           = item.limits;
+    limits.startTime = now();
+    nodes = tbHits = bestMoveChanges = 0;
+    nmpMinPly                        = 0;
+    rootDepth = completedDepth = 0;
+
+    rootMoves.clear();
+    for (const auto& m : MoveList<LEGAL>(rootPos))
+        rootMoves.emplace_back(m);
+
+    tbConfig = Tablebases::rank_root_moves(options, rootPos, rootMoves);
+
+    BatchResult result{item.index, 0, Score(rootPos.checkers() ? -VALUE_MATE : VALUE_DRAW, rootPos),
+                       0, 0, ""};
+    if (rootMoves.empty())
+        return result;
+
+    aloneStop = aloneAborted = false;
+    aloneCallsCnt            = 0;
+    stopSignal               = &aloneStop;
+    abortedSignal            = &aloneAborted;
+    searchingAlone           = true;
+
+    accumulatorStack.reset();
+    iterative_deepening();
+
+    searchingAlone = false;
+    stopSignal     = &threads.stop;
+    abortedSignal  = &threads.abortedSearch;
+
+    const RootMove& rm = rootMoves[0];
+    Value v = rm.score != -VALUE_INFINITE ? rm.uciScore : rm.previousScore;
+
+    result.depth  = completedDepth;
+    result.score  = Score(v == -VALUE_INFINITE ? VALUE_ZERO : v, rootPos);
+    result.timeMs = now() - limits.startTime;
+    result.nodes  = nodes;
+
+    for (Move m : rm.pv)
+        result.pv += (result.pv.empty() ? "" : " ") + UCIEngine::move(m, rootPos.is_chess960());
+
+    return result;
 }
 
 // Main iterative deepening loop. It calls search()
@@ -258,7 +416,10 @@ void Search::Worker::start_searching() {
 // consumed, the user stops the search, or the maximum search depth is reached.
 void Search::Worker::iterative_deepening() {
 
-    SearchManager* mainThread = (is_mainthread() ? main_manager() : nullptr);
+    // A worker searching alone or in the background reports nothing and
+    // manages its own limits
+    SearchManager* mainThread =
+      (is_mainthread() && !searchingAlone && !inBackground ? main_manager() : nullptr);
 
     Move pv[MAX_PLY + 1];
 
@@ -319,8 +480,8 @@ void Search::Worker::iterative_deepening() {
               (mainHistory[c][i] - mainHistoryDefault) * 3 / 4 + mainHistoryDefault;
 
     // Iterative deepening loop until requested to stop or the target depth is reached
-    while (++rootDepth < MAX_PLY && !threads.stop
-           && !(limits.depth && mainThread && rootDepth > limits.depth))
+    while (++rootDepth < MAX_PLY && !*stopSignal
+           && !(limits.depth && (mainThread || searchingAlone) && rootDepth > limits.depth))
     {
         // Age out PV variability metric
         if (mainThread)
@@ -385,7 +546,7 @@ void Search::Worker::iterative_deepening() {
                 // If search has been stopped, we break immediately. Sorting is
                 // safe because RootMoves is still valid, although it refers to
                 // the previous iteration.
-                if (threads.stop)
+                if (*stopSignal)
                     break;
 
                 // When failing high/low give some update before a re-search. To avoid
@@ -424,25 +585,25 @@ void Search::Worker::iterative_deepening() {
             std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
 
             if (mainThread
-                && (threads.stop || pvIdx + 1 == multiPV || nodes > 10000000)
+                && (*stopSignal || pvIdx + 1 == multiPV || nodes > 10000000)
                 // A thread that aborted search can have mated-in/TB-loss PV and
                 // score that cannot be trusted, i.e. it can be delayed or refuted
                 // if we would have had time to fully search other root-moves. Thus
                 // we suppress this output and below pick a proven score/PV for this
                 // thread (from the previous iteration).
-                && !(threads.abortedSearch && is_loss(rootMoves[0].uciScore)))
+                && !(*abortedSignal && is_loss(rootMoves[0].uciScore)))
                 main_manager()->pv(*this, threads, tt, rootDepth);
 
-            if (threads.stop)
+            if (*stopSignal)
                 break;
         }
 
-        if (!threads.stop)
+        if (!*stopSignal)
             completedDepth = rootDepth;
 
         // We make sure not to pick an unproven mated-in score,
         // in case this thread prematurely stopped search (aborted-search).
-        if (threads.abortedSearch && rootMoves[0].score != -VALUE_INFINITE
+        if (*abortedSignal && rootMoves[0].score != -VALUE_INFINITE
             && is_loss(rootMoves[0].score))
         {
             // Bring the last best move to the front for best thread selection.
@@ -461,6 +622,10 @@ void Search::Worker::iterative_deepening() {
         if (!mainThread)
             continue;
 
+        // A preemption requested during the iteration takes effect now that it is complete
+        if (threads.stopAfterIteration)
+            threads.stop = true;
+
         // Have we found a "mate in x"?
         if (limits.mate && rootMoves[0].score == rootMoves[0].uciScore
             && ((rootMoves[0].score >= VALUE_MATE_IN_MAX_PLY
@@ -474,12 +639,17 @@ void Search::Worker::iterative_deepening() {
         if (skill.enabled() && skill.time_to_pick(rootDepth))
             skill.pick_best(rootMoves, multiPV);
 
-        // Use part of the gained time from a previous stable move for the current move
+        // Use part of the gained time from a previous stable move for the current move.
+        // Threads searching another reply while pondering are left out.
+        size_t rootThreads = 0;
+
         for (auto&& th : threads)
-        {
-            totBestMoveChanges += th->worker->bestMoveChanges;
-            th->worker->bestMoveChanges = 0;
-        }
+            if (!th->worker->rootIdx)
+            {
+                totBestMoveChanges += th->worker->bestMoveChanges;
+                th->worker->bestMoveChanges = 0;
+                ++rootThreads;
+            }
 
         // Do we have time for the next iteration? Can we stop searching now?
         if (limits.use_time_management() && !threads.stop && !mainThread->stopOnPonderhit)
@@ -500,7 +670,7 @@ void Search::Worker::iterative_deepening() {
 
             double reduction = (1.43 + mainThread->previousTimeReduction) / (2.28 * timeReduction);
 
-            double bestMoveInstability = 1.02 + 2.14 * totBestMoveChanges / threads.size();
+            double bestMoveInstability = 1.02 + 2.14 * totBestMoveChanges / rootThreads;
 
             double highBestMoveEffort = nodesEffort >= 93340 ? 0.76 : 1.0;
 
@@ -606,6 +776,7 @@ void Search::Worker::clear() {
     for (size_t i = 1; i < reductions.size(); ++i)
         reductions[i] = int(2747 / 128.0 * std::log(i));
 
+    accumulatorStack.set_big_network(networks[numaAccessToken].big != nullptr);
     refreshTable.clear(networks[numaAccessToken]);
 }
 
@@ -663,7 +834,11 @@ Value Search::Worker::search(
     maxValue      = VALUE_INFINITE;
 
     // Check for the available remaining time
-    if (is_mainthread())
+    if (searchingAlone)
+        check_alone_limits();
+    else if (inBackground)
+        throttle();
+    else if (is_mainthread())
         main_manager()->check_time(*this);
 
     // Used to send selDepth info to GUI (selDepth counts from 1, ply from 0)
@@ -673,7 +848,7 @@ Value Search::Worker::search(
     if (!rootNode)
     {
         // Step 2. Check for aborted search and immediate draw
-        if (threads.stop.load(std::memory_order_relaxed) || pos.is_draw(ss->ply)
+        if (stopSignal->load(std::memory_order_relaxed) || pos.is_draw(ss->ply)
             || ss->ply >= MAX_PLY)
             return (ss->ply >= MAX_PLY && !ss->inCheck) ? evaluate(pos) : value_draw(nodes);
 
@@ -701,7 +876,7 @@ Value Search::Worker::search(
     // Step 4. Transposition table lookup
     excludedMove                   = ss->excludedMove;
     posKey                         = pos.key();
-    auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+    auto [ttHit, ttData, ttWriter] = tt.probe(posKey, ttCache);
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = rootNode ? rootMoves[pvIdx].pv[0] : ttHit ? ttData.move : Move::none();
@@ -737,8 +912,8 @@ Value Search::Worker::search(
         ss->staticEval = eval = to_corrected_static_eval(unadjustedStaticEval, correctionValue);
 
         // Static evaluation is saved as it was before adjustment by correction history
-        ttWriter.write(posKey, VALUE_NONE, ss->ttPv, BOUND_NONE, DEPTH_UNSEARCHED, Move::none(),
-                       unadjustedStaticEval, tt.generation());
+        ttCache.write(ttWriter, posKey, VALUE_NONE, ss->ttPv, BOUND_NONE, DEPTH_UNSEARCHED,
+                      Move::none(), unadjustedStaticEval, tt.generation());
     }
 
     // Set up the improving flag, which is true if current static evaluation is
@@ -784,7 +959,7 @@ Value Search::Worker::search(
             {
                 pos.do_move(ttData.move, st);
                 Key nextPosKey                             = pos.key();
-                auto [ttHitNext, ttDataNext, ttWriterNext] = tt.probe(nextPosKey);
+                auto [ttHitNext, ttDataNext, ttWriterNext] = tt.probe(nextPosKey, ttCache);
                 pos.undo_move(ttData.move);
 
                 // Check that the ttValue after the tt move would also trigger a cutoff
@@ -835,9 +1010,9 @@ Value Search::Worker::search(
 
                 if (b == BOUND_EXACT || (b == BOUND_LOWER ? value >= beta : value <= alpha))
                 {
-                    ttWriter.write(posKey, value_to_tt(value, ss->ply), ss->ttPv, b,
-                                   std::min(MAX_PLY - 1, depth + 6), Move::none(), VALUE_NONE,
-                                   tt.generation());
+                    ttCache.write(ttWriter, posKey, value_to_tt(value, ss->ply), ss->ttPv, b,
+                                  std::min(MAX_PLY - 1, depth + 6), Move::none(), VALUE_NONE,
+                                  tt.generation());
 
                     return value;
                 }
@@ -971,8 +1146,9 @@ Value Search::Worker::search(
             if (value >= probCutBeta)
             {
                 // Save ProbCut data into transposition table
-                ttWriter.write(posKey, value_to_tt(value, ss->ply), ss->ttPv, BOUND_LOWER,
-                               probCutDepth + 1, move, unadjustedStaticEval, tt.generation());
+                ttCache.write(ttWriter, posKey, value_to_tt(value, ss->ply), ss->ttPv,
+                              BOUND_LOWER, probCutDepth + 1, move, unadjustedStaticEval,
+                              tt.generation());
 
                 if (!is_decisive(value))
                     return value - (probCutBeta - beta);
@@ -1021,7 +1197,7 @@ moves_loop:  // When in check, search starts here
 
         ss->moveCount = ++moveCount;
 
-        if (rootNode && is_mainthread() && nodes > 10000000)
+        if (rootNode && is_mainthread() && !searchingAlone && !inBackground && nodes > 10000000)
         {
             main_manager()->updates.onIter(
               {depth, UCIEngine::move(move, pos.is_chess960()), moveCount + pvIdx});
@@ -1298,7 +1474,7 @@ moves_loop:  // When in check, search starts here
         // Finished searching the move. If a stop occurred, the return value of
         // the search cannot be trusted, and we return immediately without updating
         // best move, principal variation nor transposition table.
-        if (threads.stop.load(std::memory_order_relaxed))
+        if (stopSignal->load(std::memory_order_relaxed))
             return VALUE_ZERO;
 
         if (rootNode)
@@ -1463,12 +1639,12 @@ moves_loop:  // When in check, search starts here
     // Write gathered information in transposition table. Note that the
     // static evaluation is saved as it was before correction history.
     if (!excludedMove && !(rootNode && pvIdx))
-        ttWriter.write(posKey, value_to_tt(bestValue, ss->ply), ss->ttPv,
-                       bestValue >= beta    ? BOUND_LOWER
-                       : PvNode && bestMove ? BOUND_EXACT
-                                            : BOUND_UPPER,
-                       moveCount != 0 ? depth : std::min(MAX_PLY - 1, depth + 6), bestMove,
-                       unadjustedStaticEval, tt.generation());
+        ttCache.write(ttWriter, posKey, value_to_tt(bestValue, ss->ply), ss->ttPv,
+                      bestValue >= beta    ? BOUND_LOWER
+                      : PvNode && bestMove ? BOUND_EXACT
+                                           : BOUND_UPPER,
+                      moveCount != 0 ? depth : std::min(MAX_PLY - 1, depth + 6), bestMove,
+                      unadjustedStaticEval, tt.generation());
 
     // Adjust correction history if the best move is not a capture
     // and the error direction matches whether we are above/below bounds.
@@ -1541,7 +1717,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
 
     // Step 3. Transposition table lookup
     posKey                         = pos.key();
-    auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+    auto [ttHit, ttData, ttWriter] = tt.probe(posKey, ttCache);
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = ttHit ? ttData.move : Move::none();
@@ -1592,9 +1768,9 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
                 bestValue = (bestValue + beta) / 2;
 
             if (!ss->ttHit)
-                ttWriter.write(posKey, value_to_tt(bestValue, ss->ply), false, BOUND_LOWER,
-                               DEPTH_UNSEARCHED, Move::none(), unadjustedStaticEval,
-                               tt.generation());
+                ttCache.write(ttWriter, posKey, value_to_tt(bestValue, ss->ply), false,
+                              BOUND_LOWER, DEPTH_UNSEARCHED, Move::none(), unadjustedStaticEval,
+                              tt.generation());
             return bestValue;
         }
 
@@ -1723,9 +1899,9 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
 
     // Save gathered info in transposition table. The static evaluation
     // is saved as it was before adjustment by correction history.
-    ttWriter.write(posKey, value_to_tt(bestValue, ss->ply), pvHit,
-                   bestValue >= beta ? BOUND_LOWER : BOUND_UPPER, DEPTH_QS, bestMove,
-                   unadjustedStaticEval, tt.generation());
+    ttCache.write(ttWriter, posKey, value_to_tt(bestValue, ss->ply), pvHit,
+                  bestValue >= beta ? BOUND_LOWER : BOUND_UPPER, DEPTH_QS, bestMove,
+                  unadjustedStaticEval, tt.generation());
 
     assert(bestValue > -VALUE_INFINITE && bestValue < VALUE_INFINITE);
 
@@ -1960,7 +2136,10 @@ void SearchManager::check_time(Search::Worker& worker) {
 
     // We should not stop pondering until told so by the GUI
     if (ponder)
+    {
+        speculation.pondered = elapsed;
         return;
+    }
 
     if (
       // Later we rely on the fact that we can at least use the mainthread previous
@@ -1972,6 +2151,49 @@ void SearchManager::check_time(Search::Worker& worker) {
         worker.threads.stop = worker.threads.abortedSearch = true;
 }
 
+// The counterpart of SearchManager::check_time() for a worker searching alone.
+// A stop of the whole pool also ends its search.
+void Search::Worker::check_alone_limits() {
+    if (--aloneCallsCnt > 0)
+        return;
+
+    aloneCallsCnt = limits.nodes ? std::min(512, int(limits.nodes / 1024)) : 512;
+
+    if (threads.stop
+        || (completedDepth >= 1
+            && ((limits.movetime && now() - limits.startTime >= limits.movetime)
+                || (limits.nodes && nodes >= limits.nodes))))
+        aloneStop = aloneAborted = true;
+}
+
+// Keeps a worker searching in the background within cpuBudget percent of the
+// time: after each burst of searching, it sleeps in short naps, so that a stop
+// is seen within a few milliseconds.
+void Search::Worker::throttle() {
+    if (--throttleCallsCnt > 0)
+        return;
+
+    throttleCallsCnt = 512;
+
+    if (cpuBudget >= 100)
+        return;
+
+    constexpr TimePoint Burst = 10, Nap = 2;
+
+    const TimePoint busy = now() - busySince;
+
+    if (busy < Burst)
+        return;
+
+    busyTime += busy;
+
+    for (TimePoint rest = busy * (100 - cpuBudget) / cpuBudget; rest > 0 && !threads.stop;
+         rest -= Nap)
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(rest, Nap)));
+
+    busySince = now();
+}
+
 // Used to correct and extend PVs for moves that have a TB (but not a mate) score.
 // Keeps the search based PV for as long as it is verified to maintain the game
 // outcome, truncates afterwards. Finally, extends to mate the PV, providing a
@@ -2146,14 +2368,16 @@ void SearchManager::pv(Search::Worker&           worker,
             syzygy_extend_pv(worker.options, worker.limits, pos, rootMoves[i], v);
 
         std::string pv;
-        for (Move m : rootMoves[i].pv)
-            pv += UCIEngine::move(m, pos.is_chess960()) + " ";
+        if (updates.formatInfo)
+            for (Move m : rootMoves[i].pv)
+                pv += UCIEngine::move(m, pos.is_chess960()) + " ";
 
         // Remove last whitespace
         if (!pv.empty())
             pv.pop_back();
 
-        auto wdl   = worker.options["UCI_ShowWDL"] ? UCIEngine::wdl(v, pos) : "";
+        auto wdl =
+          updates.formatInfo && worker.options["UCI_ShowWDL"] ? UCIEngine::wdl(v, pos) : "";
         auto bound = rootMoves[i].scoreLowerbound
                      ? "lowerbound"
                      : (rootMoves[i].scoreUpperbound ? "upperbound" : "");
@@ -2177,6 +2401,10 @@ void SearchManager::pv(Search::Worker&           worker,
         info.pv        = pv;
         info.hashfull  = tt.hashfull();
 
+        info.pvMoves     = rootMoves[i].pv.data();
+        info.pvLength    = rootMoves[i].pv.size();
+        info.wdlPerMille = UCIEngine::wdl_per_mille(v, pos);
+
         updates.onUpdateFull(info);
     }
 }
@@ -41,6 +41,7 @@
 #include "score.h"
 #include "syzygy/tbprobe.h"
 #include "timeman.h"
+#include "tt.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -134,22 +135,22 @@ struct LimitsType {
 // The UCI stores the uci options, thread pool, and transposition table.
 // This struct is used to easily forward data to the Search::Worker class.
 struct SharedState {
-    SharedState(const OptionsMap&                                         optionsMap,
-                ThreadPool&                                               threadPool,
-                TranspositionTable&                                       transpositionTable,
-                std::map<NumaIndex, SharedHistories>&                     sharedHists,
-                const LazyNumaReplicatedSystemWide<Eval::NNUE::Networks>& nets) :
+    SharedState(const OptionsMap&                     optionsMap,
+                ThreadPool&                           threadPool,
+                TranspositionTable&                   transpositionTable,
+                std::map<NumaIndex, SharedHistories>& sharedHists,
+                const Eval::NNUE::ReplicatedNetworks& nets) :
         options(optionsMap),
         threads(threadPool),
         tt(transpositionTable),
         sharedHistories(sharedHists),
         networks(nets) {}
 
-    const OptionsMap&                                         options;
-    ThreadPool&                                               threads;
-    TranspositionTable&                                       tt;
-    std::map<NumaIndex, SharedHistories>&                     sharedHistories;
-    const LazyNumaReplicatedSystemWide<Eval::NNUE::Networks>& networks;
+    const OptionsMap&                     options;
+    ThreadPool&                           threads;
+    TranspositionTable&                   tt;
+    std::map<NumaIndex, SharedHistories>& sharedHistories;
+    const Eval::NNUE::ReplicatedNetworks& networks;
 };
 
 class Worker;
@@ -178,6 +179,11 @@ struct InfoFull: InfoShort {
     size_t           tbHits;
     std::string_view pv;
     int              hashfull;
+
+    // Raw data for consumers that do not want to parse the strings above
+    const Move*        pvMoves;
+    size_t             pvLength;
+    std::array<int, 3> wdlPerMille;
 };
 
 struct InfoIteration {
@@ -186,6 +192,46 @@ struct InfoIteration {
     size_t           currmovenumber;
 };
 
+// A position of a batch analysis, searched by a single thread. Only the depth,
+// nodes and movetime limits are honored.
+struct BatchItem {
+    size_t      index;
+    std::string fen;
+    LimitsType  limits;
+};
+
+struct BatchResult {
+    size_t      index;
+    int         depth;
+    Score       score;
+    size_t      timeMs;
+    size_t      nodes;
+    std::string pv;  // in UCI notation, empty if there is no legal move
+};
+
+// Outcome of the ponder searches split over several replies of the opponent,
+// see ThreadPool::start_thinking(), and of the background searches after
+// bestmove, see ThreadPool::search_in_background(). Times add up those of the
+// threads: one ms of pondering with 4 threads on a reply counts as 4 ms.
+struct PonderStats {
+    uint64_t speculations  = 0;  // searches of replies, split or in the background
+    uint64_t hits          = 0;  // the expected reply was played
+    uint64_t alternateHits = 0;  // another reply searched was played, and taken over
+    uint64_t misses        = 0;  // none of the replies searched was played
+    uint64_t hitTime       = 0;  // ms spent on the replies played
+    uint64_t pondered      = 0;  // ms spent pondering in all
+    uint64_t depthTaken    = 0;  // iterations skipped by taking the replies played over
+
+    uint64_t backgroundSearches = 0;
+    uint64_t backgroundNodes    = 0;
+    uint64_t backgroundBusy     = 0;  // ms the threads were searching
+    uint64_t backgroundTime     = 0;  // ms from bestmove to the next command, of all threads
+    uint64_t backgroundHashfull = 0;  // permille of the hash written, summed over the searches
+    uint64_t preemptions        = 0;  // background searches stopped by a command
+    uint64_t preemptTime        = 0;  // us taken to stop them
+    uint64_t preemptMax         = 0;  // us
+};
+
 // Skill structure is used to implement strength limit. If we have a UCI_Elo,
 // we convert it to an appropriate skill level, anchored to the Stash engine.
 // This method is based on a fit of the Elo results for games played between
@@ -228,6 +274,9 @@ class SearchManager: public ISearchManager {
         UpdateFull     onUpdateFull;
         UpdateIter     onIter;
         UpdateBestmove onBestmove;
+
+        // When false, the pv and wdl strings of InfoFull are left empty
+        bool formatInfo = true;
     };
 
 
@@ -252,6 +301,43 @@ class SearchManager: public ISearchManager {
     Value                bestPreviousAverageScore;
     bool                 stopOnPonderhit;
 
+    // The outcome of the last search, which the next one takes over when its
+    // root is reached by the first moves of the PV, see ThreadPool::start_thinking()
+    struct PreviousSearch {
+        Key               rootKey   = 0;
+        Key               pvKeys[2] = {};  // After the first and the second move of the PV
+        std::vector<Move> pv;
+        Depth             depth = 0;
+        Value             score = VALUE_NONE;
+
+        // 1 or 2 if pos was reached from the root by as many moves of the PV,
+        // with the PV going on from there, else 0
+        int plies_to(const Position& pos) const;
+    };
+
+    PreviousSearch previous;
+
+    // The replies searched while pondering, when split over several of them
+    struct SpeculativeRoot {
+        Key               key;
+        size_t            threads;  // Searching it
+        std::vector<Move> pv;
+        Depth             depth = 0;
+        Value             score = VALUE_NONE;
+    };
+
+    struct Speculation {
+        Key                          parentKey = 0;  // Before the reply
+        std::vector<SpeculativeRoot> roots;          // roots[0] is the expected reply
+        TimePoint                    pondered = 0;
+
+        // The index of the root pos is, reached by its reply, or -1
+        int find(const Position& pos) const;
+    };
+
+    Speculation speculation;
+    PonderStats ponderStats;
+
     size_t id;
 
     const UpdateContext& updates;
@@ -282,6 +368,10 @@ class Worker {
     // It searches from the root position and outputs the "bestmove".
     void start_searching();
 
+    // Searches a batch item alone on this thread, checking its limits itself,
+    // so that every thread of the pool can work on a different position.
+    BatchResult search_alone(const BatchItem& item);
+
     bool is_mainthread() const { return threadIdx == 0; }
 
     void ensure_network_replicated();
@@ -297,6 +387,12 @@ class Worker {
     TTMoveHistory    ttMoveHistory;
     SharedHistories& sharedHistory;
 
+    TTCache ttCache;  // Sized by Engine::set_tt_cache_size()
+
+#ifdef TT_STATS
+    TTCounters ttCounters;  // Probes and writes of this thread
+#endif
+
    private:
     void iterative_deepening();
 
@@ -326,6 +422,10 @@ class Worker {
     TimePoint elapsed() const;
     TimePoint elapsed_time() const;
 
+    void check_alone_limits();
+    void throttle();
+    void keep_speculative_roots();
+
     Value evaluate(const Position&);
 
     LimitsType limits;
@@ -339,6 +439,7 @@ class Worker {
     Position  rootPos;
     StateInfo rootState;
     RootMoves rootMoves;
+    size_t    rootIdx = 0;  // Of the speculative root searched, 0 for the root of the search
     Depth     rootDepth, completedDepth;
     Value     rootDelta;
 
@@ -351,12 +452,26 @@ class Worker {
     // The main thread has a SearchManager, the others have a NullSearchManager
     std::unique_ptr<ISearchManager> manager;
 
+    // Polled to end the search: the flags of the ThreadPool, or the worker's
+    // own ones while it searches alone.
+    std::atomic_bool* stopSignal;
+    std::atomic_bool* abortedSignal;
+    std::atomic_bool  aloneStop, aloneAborted;
+    bool              searchingAlone = false;
+    int               aloneCallsCnt;
+
+    // Searching in the background after bestmove, within cpuBudget percent
+    // of the time, see throttle()
+    bool      inBackground = false;
+    int       cpuBudget, throttleCallsCnt;
+    TimePoint busySince, busyTime;
+
     Tablebases::Config tbConfig;
 
-    const OptionsMap&                                         options;
-    ThreadPool&                                               threads;
-    TranspositionTable&                                       tt;
-    const LazyNumaReplicatedSystemWide<Eval::NNUE::Networks>& networks;
+    const OptionsMap&                     options;
+    ThreadPool&                           threads;
+    TranspositionTable&                   tt;
+    const Eval::NNUE::ReplicatedNetworks& networks;
 
     // Used by NNUE
     Eval::NNUE::AccumulatorStack  accumulatorStack;
@@ -173,9 +173,17 @@ class SharedMemory: public detail::SharedMemoryBase {
     size_t             total_size_ = 0;
     std::string        sentinel_base_;
     std::string        sentinel_path_;
+    size_t             count_       = 1;
+    bool               reset_stale_ = false;
 
-    static constexpr size_t calculate_total_size() noexcept {
-        return sizeof(T) + sizeof(detail::ShmHeader);
+    // The header follows the data, aligned for its mutex
+    static constexpr size_t data_size(size_t count) noexcept {
+        constexpr size_t align = alignof(detail::ShmHeader);
+        return (sizeof(T) * count + align - 1) / align * align;
+    }
+
+    static constexpr size_t calculate_total_size(size_t count = 1) noexcept {
+        return data_size(count) + sizeof(detail::ShmHeader);
     }
 
     static std::string make_sentinel_base(const std::string& name) {
@@ -192,6 +200,16 @@ class SharedMemory: public detail::SharedMemoryBase {
         total_size_(calculate_total_size()),
         sentinel_base_(make_sentinel_base(name)) {}
 
+    // A mutable array of count elements, zero-initialized when created by
+    // open(). A region left behind by processes that are all gone is stale and
+    // is recreated rather than reused.
+    SharedMemory(const std::string& name, size_t count) noexcept :
+        name_(name),
+        total_size_(calculate_total_size(count)),
+        sentinel_base_(make_sentinel_base(name)),
+        count_(count),
+        reset_stale_(true) {}
+
     ~SharedMemory() noexcept override {
         detail::SharedMemoryRegistry::unregister_instance(this);
         close();
@@ -208,7 +226,9 @@ class SharedMemory: public detail::SharedMemoryBase {
         header_ptr_(other.header_ptr_),
         total_size_(other.total_size_),
         sentinel_base_(std::move(other.sentinel_base_)),
-        sentinel_path_(std::move(other.sentinel_path_)) {
+        sentinel_path_(std::move(other.sentinel_path_)),
+        count_(other.count_),
+        reset_stale_(other.reset_stale_) {
 
         detail::SharedMemoryRegistry::unregister_instance(&other);
         detail::SharedMemoryRegistry::register_instance(this);
@@ -229,6 +249,8 @@ class SharedMemory: public detail::SharedMemoryBase {
             total_size_    = other.total_size_;
             sentinel_base_ = std::move(other.sentinel_base_);
             sentinel_path_ = std::move(other.sentinel_path_);
+            count_         = other.count_;
+            reset_stale_   = other.reset_stale_;
 
             detail::SharedMemoryRegistry::unregister_instance(&other);
             detail::SharedMemoryRegistry::register_instance(this);
@@ -238,7 +260,13 @@ class SharedMemory: public detail::SharedMemoryBase {
         return *this;
     }
 
-    [[nodiscard]] bool open(const T& initial_value) noexcept {
+    [[nodiscard]] bool open(const T& initial_value) noexcept { return open_region(&initial_value); }
+
+    // Opens an array region, see SharedMemory(name, count)
+    [[nodiscard]] bool open() noexcept { return open_region(nullptr); }
+
+   private:
+    [[nodiscard]] bool open_region(const T* initial_value) noexcept {
         detail::CleanupHooks::ensure_registered();
 
         bool retried_stale = false;
@@ -307,6 +335,21 @@ class SharedMemory: public detail::SharedMemoryBase {
                 return false;
             }
 
+            // Nobody is attached anymore: the content of a mutable region is
+            // not trusted, so it is dropped and created again.
+            if (!created_new && reset_stale_ && !retried_stale
+                && !has_other_live_sentinels_locked())
+            {
+                unlock_shared_mutex();
+                unmap_region();
+                shm_unlink(name_.c_str());
+                unlock_file();
+                ::close(fd_);
+                reset();
+                retried_stale = true;
+                continue;
+            }
+
             if (!create_sentinel_file_locked())
             {
                 unlock_shared_mutex();
@@ -328,6 +371,7 @@ class SharedMemory: public detail::SharedMemoryBase {
         }
     }
 
+   public:
     void close(bool skip_unmap = false) noexcept override {
         if (fd_ == -1 && mapped_ptr_ == nullptr)
             return;
@@ -386,6 +430,10 @@ class SharedMemory: public detail::SharedMemoryBase {
 
     [[nodiscard]] const T& operator*() const noexcept { return *data_ptr_; }
 
+    [[nodiscard]] T* data() const noexcept { return data_ptr_; }
+
+    [[nodiscard]] size_t count() const noexcept { return count_; }
+
     [[nodiscard]] uint32_t ref_count() const noexcept {
         return header_ptr_ ? header_ptr_->ref_count.load(std::memory_order_acquire) : 0;
     }
@@ -594,7 +642,7 @@ class SharedMemory: public detail::SharedMemoryBase {
         return found;
     }
 
-    [[nodiscard]] bool setup_new_region(const T& initial_value) noexcept {
+    [[nodiscard]] bool setup_new_region(const T* initial_value) noexcept {
         if (ftruncate(fd_, static_cast<off_t>(total_size_)) == -1)
             return false;
 
@@ -610,10 +658,13 @@ class SharedMemory: public detail::SharedMemoryBase {
 
         data_ptr_ = static_cast<T*>(mapped_ptr_);
         header_ptr_ =
-          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + sizeof(T));
+          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + data_size(count_));
 
         new (header_ptr_) detail::ShmHeader{};
-        new (data_ptr_) T{initial_value};
+
+        // An array is left zero-filled, as ftruncate() gives it
+        if (initial_value)
+            new (data_ptr_) T{*initial_value};
 
         if (!initialize_shared_mutex())
             return false;
@@ -642,8 +693,8 @@ class SharedMemory: public detail::SharedMemoryBase {
         }
 
         data_ptr_   = static_cast<T*>(mapped_ptr_);
-        header_ptr_ = std::launder(
-          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + sizeof(T)));
+        header_ptr_ = std::launder(reinterpret_cast<detail::ShmHeader*>(
+          static_cast<char*>(mapped_ptr_) + data_size(count_)));
 
         if (!header_ptr_->initialized.load(std::memory_order_acquire)
             || header_ptr_->magic != detail::ShmHeader::SHM_MAGIC)
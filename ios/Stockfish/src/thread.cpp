@@ -20,6 +20,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <deque>
 #include <map>
 #include <memory>
@@ -99,6 +101,13 @@ void Thread::wait_for_search_finished() {
     cv.wait(lk, [&] { return !searching; });
 }
 
+// Tells whether the thread is still busy, without blocking
+bool Thread::is_searching() {
+
+    std::lock_guard<std::mutex> lk(mutex);
+    return searching;
+}
+
 // Launching a function in the thread
 void Thread::run_custom_job(std::function<void()> f) {
     {
@@ -120,7 +129,7 @@ void Thread::idle_loop() {
     {
         std::unique_lock<std::mutex> lk(mutex);
         searching = false;
-        cv.notify_one();  // Wake up anyone waiting for search finished
+        cv.notify_all();  // Wake up everyone waiting for search finished
         cv.wait(lk, [&] { return searching; });
 
         if (exit)
@@ -143,6 +152,10 @@ uint64_t ThreadPool::tb_hits() const { return accumulate(&Search::Worker::tbHits
 
 static size_t next_power_of_two(uint64_t count) { return count > 1 ? (2ULL << msb(count - 1)) : 1; }
 
+// Iterations searched again below the depth the previous search reached in
+// the subtree of a root taken over from it
+constexpr Depth ReuseDepthMargin = 2;
+
 // Creates/destroys threads to match the requested number.
 // Created and launched threads will immediately go to sleep in idle_loop.
 // Upon resizing, threads are recreated to allow for binding if necessary.
@@ -152,6 +165,7 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
 
     if (threads.size() > 0)  // destroy any existing thread(s)
     {
+        end_background();
         main_thread()->wait_for_search_finished();
 
         threads.clear();
@@ -252,6 +266,8 @@ void ThreadPool::clear() {
     if (threads.size() == 0)
         return;
 
+    end_background();
+
     for (auto&& th : threads)
         th->clear_worker();
 
@@ -265,6 +281,8 @@ void ThreadPool::clear() {
     main_manager()->callsCnt           = 0;
     main_manager()->bestPreviousScore  = VALUE_INFINITE;
     main_manager()->originalTimeAdjust = -1;
+    main_manager()->previous           = {};
+    main_manager()->speculation        = {};
     main_manager()->tm.clear();
 }
 
@@ -288,10 +306,11 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
                                 StateListPtr&      states,
                                 Search::LimitsType limits) {
 
+    end_background();
     main_thread()->wait_for_search_finished();
 
-    main_manager()->stopOnPonderhit = stop = abortedSearch = false;
-    main_manager()->ponder                                 = limits.ponderMode;
+    main_manager()->stopOnPonderhit = stop = abortedSearch = stopAfterIteration = false;
+    main_manager()->ponder                                              = limits.ponderMode;
 
     increaseDepth = true;
 
@@ -310,6 +329,76 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
         for (const auto& m : legalmoves)
             rootMoves.emplace_back(m);
 
+    // A root reached by the first moves of the previous PV is searched from
+    // where that search left off: the rest of the PV first, with an aspiration
+    // window around its score, and the first iterations skipped, as the
+    // transposition table holds their results. Before the tablebase ranking,
+    // which sorts the moves in a stable way.
+    Depth startDepth = 0;
+
+    auto&               previous    = main_manager()->previous;
+    auto&               speculation = main_manager()->speculation;
+    auto&               ponderStats = main_manager()->ponderStats;
+    const Search::Skill skill(options["Skill Level"],
+                              options["UCI_LimitStrength"] ? int(options["UCI_Elo"]) : 0);
+
+    const bool reuse = options["SearchReuse"] && limits.searchmoves.empty()
+                    && int(options["MultiPV"]) == 1 && !skill.enabled();
+
+    auto take_over = [&](const std::vector<Move>& pv, int plies, Value v, Depth depth) {
+        auto rm = std::find(rootMoves.begin(), rootMoves.end(), pv[plies]);
+
+        if (rm == rootMoves.end())
+            return false;
+
+        std::rotate(rootMoves.begin(), rm, rm + 1);
+        rootMoves[0].pv.assign(pv.begin() + plies, pv.end());
+
+        if (std::abs(v) < VALUE_TB_WIN_IN_MAX_PLY)
+        {
+            rootMoves[0].score = rootMoves[0].uciScore = rootMoves[0].averageScore = v;
+            rootMoves[0].meanSquaredScore = v * std::abs(v);
+        }
+
+        startDepth = std::max(depth - plies - ReuseDepthMargin, 0);
+
+        if (limits.depth)
+            startDepth = std::min(startDepth, limits.depth - 1);
+
+        return true;
+    };
+
+    // After a ponder search split over several replies, the one played is
+    // taken over in the same way if it was among them
+    bool takenOver = false;
+
+    if (!speculation.roots.empty())
+    {
+        const int i = speculation.find(pos);
+
+        if (i < 0)
+            ++ponderStats.misses;
+        else
+        {
+            const auto& root = speculation.roots[i];
+
+            ++(i ? ponderStats.alternateHits : ponderStats.hits);
+            ponderStats.hitTime += uint64_t(speculation.pondered) * root.threads;
+
+            if (reuse && !root.pv.empty()
+                && (takenOver = take_over(root.pv, 0, root.score, root.depth)))
+                ponderStats.depthTaken += startDepth;
+        }
+
+        speculation = {};
+    }
+
+    const int plies = previous.plies_to(pos);
+
+    if (reuse && plies && !takenOver)
+        take_over(previous.pv, plies, plies % 2 ? -previous.score : previous.score,
+                  previous.depth);
+
     Tablebases::Config tbConfig = Tablebases::rank_root_moves(options, pos, rootMoves);
 
     // After ownership transfer 'states' becomes empty, so if we stop the search
@@ -324,24 +413,336 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
     // be deduced from a fen string, so set() clears them and they are set from
     // setupStates->back() later. The rootState is per thread, earlier states are
     // shared since they are read-only.
+    std::vector<SearchRoot> roots;
+    roots.push_back({previous.score, size(), setupStates->back(), pos.fen(), std::move(rootMoves),
+                     tbConfig, startDepth});
+
+    // Pondering on the expected reply of the PV, the threads can be split over
+    // the best replies instead, see add_speculative_replies(). The main thread
+    // stays on the expected reply, the others search a reply each, which
+    // start_searching() keeps for the next search.
+    const bool split = int(options["PonderCandidates"]) > 1 && size() > 1
+                    && limits.searchmoves.empty() && int(options["MultiPV"]) == 1
+                    && !skill.enabled();
+
+    if (limits.ponderMode && split && plies == 2)
+        add_speculative_replies(options, pos, previous, int(options["PonderCandidates"]), roots);
+
+    if (roots.size() > 1)
+    {
+        speculation.parentKey = pos.state()->previous->key;
+
+        for (const auto& root : roots)
+            speculation.roots.push_back({root.state.key, root.threads, {}});
+
+        ++ponderStats.speculations;
+    }
+
+    // The next bestmove may be followed by a search in the background
+    background = options["BackgroundSearch"] && !limits.ponderMode && !limits.infinite
+                     && limits.searchmoves.empty() && int(options["MultiPV"]) == 1
+                     && !skill.enabled()
+                 ? Background::Allowed
+                 : Background::Off;
+
+    set_roots(roots, limits, pos.is_chess960(), false);
+
+    main_thread()->start_searching();
+}
+
+// Gives the threads their roots in turn, main thread first, and waits until
+// they have them. In the background, the main thread is already busy and sets
+// up its own.
+void ThreadPool::set_roots(const std::vector<SearchRoot>& roots,
+                           const Search::LimitsType&      limits,
+                           bool                           chess960,
+                           bool                           inBackground) {
+
+    std::vector<size_t> rootOf;
+
+    for (size_t i = 0; i < roots.size(); ++i)
+        rootOf.insert(rootOf.end(), roots[i].threads, i);
+
+    assert(rootOf.size() == size());
+
+    auto set_up = [&](Search::Worker& w, size_t idx) {
+        const SearchRoot& root = roots[idx];
+
+        w.limits = limits;
+        w.nodes = w.tbHits = w.bestMoveChanges = 0;
+        w.nmpMinPly                             = 0;
+        w.rootIdx                               = idx;
+        w.rootDepth                             = root.depth;
+        w.completedDepth                        = 0;
+        w.rootMoves                             = root.rootMoves;
+        w.rootPos.set(root.fen, chess960, &w.rootState);
+        w.rootState    = root.state;
+        w.tbConfig     = root.tbConfig;
+        w.inBackground = inBackground;
+
+        if (inBackground)
+        {
+            w.cpuBudget        = int(w.options["BackgroundCPU"]);
+            w.throttleCallsCnt = 0;
+            w.busySince        = now();
+            w.busyTime         = 0;
+        }
+    };
+
+    for (size_t t = 0; t < threads.size(); ++t)
+    {
+        auto&& th = threads[t];
+
+        if (inBackground && th == threads.front())
+            set_up(*th->worker, rootOf[t]);
+        else
+            th->run_custom_job([&, t]() { set_up(*th->worker, rootOf[t]); });
+    }
+
     for (auto&& th : threads)
+        if (!inBackground || th != threads.front())
+            th->wait_for_search_finished();
+}
+
+// Ranks the replies to the position before the last move of pos, which is the
+// reply expected by the previous search, by the scores the transposition table
+// has for them. The best count of them, roots[0] being the expected one, share
+// the threads out: a reply a pawn worse than the best one gets half as many.
+// The replies left without a thread are dropped.
+void ThreadPool::add_speculative_replies(const OptionsMap&                            options,
+                                         Position&                                    pos,
+                                         const Search::SearchManager::PreviousSearch& previous,
+                                         int                                          count,
+                                         std::vector<SearchRoot>&                     roots) {
+
+    const TranspositionTable& tt       = main_thread()->worker->tt;
+    const Move                expected = previous.pv[1];
+    StateInfo* const          st       = pos.state();
+
+    std::vector<std::pair<Value, Move>> ranked;
+
+    pos.undo_move(expected);
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+        if (m != expected)
+        {
+            StateInfo replySt;
+            pos.do_move(m, replySt);
+
+            auto [ttHit, ttData, ttWriter] = tt.probe(pos.key());
+
+            if (ttHit && ttData.value != VALUE_NONE)
+                ranked.emplace_back(ttData.value, m);
+
+            pos.undo_move(m);
+        }
+
+    // The opponent prefers the replies scored lowest for us
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    ranked.resize(std::min(ranked.size(), size_t(count - 1)));
+
+    for (const auto& [v, m] : ranked)
     {
-        th->run_custom_job([&]() {
-            th->worker->limits = limits;
-            th->worker->nodes = th->worker->tbHits = th->worker->bestMoveChanges = 0;
-            th->worker->nmpMinPly                                                = 0;
-            th->worker->rootDepth = th->worker->completedDepth = 0;
-            th->worker->rootMoves                              = rootMoves;
-            th->worker->rootPos.set(pos.fen(), pos.is_chess960(), &th->worker->rootState);
-            th->worker->rootState = setupStates->back();
-            th->worker->tbConfig  = tbConfig;
-        });
+        auto& reply = roots.emplace_back(SearchRoot{v, 0, {}, {}, {}, {}});
+        pos.do_move(m, reply.state);
+
+        for (const auto& rm : MoveList<LEGAL>(pos))
+            reply.rootMoves.emplace_back(rm);
+
+        if (!reply.rootMoves.empty())
+        {
+            reply.tbConfig = Tablebases::rank_root_moves(options, pos, reply.rootMoves);
+            reply.fen      = pos.fen();
+        }
+
+        pos.undo_move(m);
+
+        if (reply.rootMoves.empty())
+            roots.pop_back();
     }
 
+    pos.do_move(expected, *st);
+
+    Value best = VALUE_INFINITE;
+
+    for (const auto& root : roots)
+        if (std::abs(root.value) < VALUE_INFINITE)
+            best = std::min(best, root.value);
+
+    auto weight = [&](const SearchRoot& root) {
+        return std::abs(root.value) < VALUE_INFINITE
+               ? std::exp2(double(best - root.value) / PawnValue)
+               : 1.0;
+    };
+
+    // Each thread goes to the reply with the most weight per thread
+    for (auto& root : roots)
+        root.threads = 0;
+
+    roots[0].threads = 1;
+
+    for (size_t t = 1; t < size(); ++t)
+        ++std::max_element(roots.begin(), roots.end(),
+                           [&](const auto& a, const auto& b) {
+                               return weight(a) / (a.threads + 1) < weight(b) / (b.threads + 1);
+                           })
+            ->threads;
+
+    roots.erase(std::remove_if(roots.begin() + 1, roots.end(),
+                               [](const auto& root) { return !root.threads; }),
+                roots.end());
+}
+
+// Called by the main thread after bestmove. Takes the background search over
+// if start_thinking() allowed it and no command has ended it since.
+bool ThreadPool::begin_background() {
+
+    stop = abortedSearch = stopAfterIteration = false;
+    increaseDepth                             = true;
+
+    auto allowed = Background::Allowed;
+    return background.compare_exchange_strong(allowed, Background::Running);
+}
+
+// Searches on, on the main thread, the position after bestmove and the reply
+// expected by the search, or the best replies as when pondering with
+// PonderCandidates. Until a command calls end_background() or a stop comes,
+// and within BackgroundCPU percent of the time of each thread, so that the
+// transposition table is warm for the next search, which also takes over the
+// outcome if the reply is played, like after a ponder search.
+void ThreadPool::search_in_background() {
+
+    Search::Worker&   mainWorker = *main_thread()->worker;
+    const OptionsMap& options    = mainWorker.options;
+    auto&             previous   = main_manager()->previous;
+    auto&             stats      = main_manager()->ponderStats;
+    const TimePoint   start      = now();
+
+    if (previous.pv.size() < 2)
+    {
+        background = Background::Off;
+        return;
+    }
+
+    // The states of the root stay in setupStates, the search having taken them
+    Position& pos = backgroundPos;
+    pos.set(mainWorker.rootPos.fen(), mainWorker.rootPos.is_chess960(), &backgroundStates[0]);
+    backgroundStates[0] = mainWorker.rootState;
+    pos.do_move(previous.pv[0], backgroundStates[1]);
+    pos.do_move(previous.pv[1], backgroundStates[2]);
+
+    Search::RootMoves rootMoves;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+        rootMoves.emplace_back(m);
+
+    if (rootMoves.empty())
+    {
+        background = Background::Off;
+        return;
+    }
+
+    Search::LimitsType limits;
+    limits.startTime = start;
+    limits.infinite  = 1;
+
+    std::vector<SearchRoot> roots;
+    roots.push_back({previous.score, size(), backgroundStates[2], pos.fen(), std::move(rootMoves),
+                     {}, 0});
+    roots[0].tbConfig = Tablebases::rank_root_moves(options, pos, roots[0].rootMoves);
+
+    if (int(options["PonderCandidates"]) > 1 && size() > 1)
+        add_speculative_replies(options, pos, previous, int(options["PonderCandidates"]), roots);
+
+    auto& speculation     = main_manager()->speculation;
+    speculation           = {};
+    speculation.parentKey = backgroundStates[1].key;
+
+    for (const auto& root : roots)
+        speculation.roots.push_back({root.state.key, root.threads, {}});
+
+    const int hashfull = mainWorker.tt.hashfull();
+
+    set_roots(roots, limits, pos.is_chess960(), true);
+    start_searching();
+
+    mainWorker.accumulatorStack.reset();
+    mainWorker.iterative_deepening();
+
+    stop = true;
+    wait_for_search_finished();
+
+    // The time is counted at the rate of BackgroundCPU
+    const TimePoint elapsed = now() - start;
+    speculation.pondered    = elapsed * int(options["BackgroundCPU"]) / 100;
+    mainWorker.keep_speculative_roots();
+
+    ++stats.speculations;
+    ++stats.backgroundSearches;
+    stats.backgroundTime += uint64_t(elapsed) * size();
+    stats.backgroundHashfull += std::max(mainWorker.tt.hashfull() - hashfull, 0);
+    stats.pondered += uint64_t(speculation.pondered) * size();
+
     for (auto&& th : threads)
-        th->wait_for_search_finished();
+    {
+        Search::Worker& w = *th->worker;
 
-    main_thread()->start_searching();
+        stats.backgroundNodes += w.nodes;
+        stats.backgroundBusy += uint64_t(w.busyTime + now() - w.busySince);
+        w.inBackground = false;
+    }
+
+    background = Background::Off;
+}
+
+// Stops the background search, if any, and waits until it is over
+void ThreadPool::end_background() {
+
+    if (background.exchange(Background::Off) != Background::Running)
+        return;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    stop = true;
+    main_thread()->wait_for_search_finished();
+
+    const auto us = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start)
+                               .count());
+
+    auto& stats = main_manager()->ponderStats;
+    ++stats.preemptions;
+    stats.preemptTime += us;
+    stats.preemptMax = std::max(stats.preemptMax, us);
+}
+
+// Searches the items with one thread each instead of all threads on one
+// position: every thread takes the next item as soon as it is done with the
+// previous one. Returns immediately, onResult is called by the searching
+// threads and onDone by the last one to finish.
+void ThreadPool::start_batch(std::shared_ptr<const std::vector<Search::BatchItem>> items,
+                             std::function<void(const Search::BatchResult&)>       onResult,
+                             std::function<void()>                                 onDone) {
+
+    end_background();
+    main_thread()->wait_for_search_finished();
+    wait_for_search_finished();
+
+    stop = abortedSearch = false;
+    increaseDepth        = true;
+
+    auto next    = std::make_shared<std::atomic<size_t>>(0);
+    auto running = std::make_shared<std::atomic<size_t>>(threads.size());
+
+    for (auto&& th : threads)
+        th->run_custom_job([=, worker = th->worker.get()]() {
+            for (size_t i; !stop && (i = (*next)++) < items->size();)
+                onResult(worker->search_alone((*items)[i]));
+
+            if (--*running == 0)
+                onDone();
+        });
 }
 
 Thread* ThreadPool::get_best_thread() const {
@@ -352,9 +753,11 @@ Thread* ThreadPool::get_best_thread() const {
     std::unordered_map<Move, int64_t, Move::MoveHash> votes(
       2 * std::min(size(), bestThread->worker->rootMoves.size()));
 
-    // Find the minimum score of all threads
+    // Find the minimum score of all threads. Those searching another root,
+    // while pondering on several replies, are left out.
     for (auto&& th : threads)
-        minScore = std::min(minScore, th->worker->rootMoves[0].score);
+        if (!th->worker->rootIdx)
+            minScore = std::min(minScore, th->worker->rootMoves[0].score);
 
     // Vote according to score and depth, and select the best thread
     auto thread_voting_value = [minScore](Thread* th) {
@@ -362,10 +765,14 @@ Thread* ThreadPool::get_best_thread() const {
     };
 
     for (auto&& th : threads)
-        votes[th->worker->rootMoves[0].pv[0]] += thread_voting_value(th.get());
+        if (!th->worker->rootIdx)
+            votes[th->worker->rootMoves[0].pv[0]] += thread_voting_value(th.get());
 
     for (auto&& th : threads)
     {
+        if (th->worker->rootIdx)
+            continue;
+
         const auto bestThreadScore = bestThread->worker->rootMoves[0].score;
         const auto newThreadScore  = th->worker->rootMoves[0].score;
 
@@ -448,6 +855,10 @@ std::vector<size_t> ThreadPool::get_bound_thread_count_by_numa_node() const {
     return counts;
 }
 
+std::vector<NumaIndex> ThreadPool::get_bound_numa_node_by_thread() const {
+    return boundThreadToNumaNode;
+}
+
 void ThreadPool::ensure_network_replicated() {
     for (auto&& th : threads)
         th->ensure_network_replicated();
@@ -26,6 +26,7 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include "memory.h"
@@ -94,6 +95,7 @@ class Thread {
     // appropriate specificity regarding search, from the point of view of an
     // outside user, so renaming of this function is left for whenever that happens.
     void   wait_for_search_finished();
+    bool   is_searching();
     size_t id() const { return idx; }
 
     LargePagePtr<Search::Worker> worker;
@@ -120,6 +122,7 @@ class ThreadPool {
         // destroy any existing thread(s)
         if (threads.size() > 0)
         {
+            end_background();
             main_thread()->wait_for_search_finished();
 
             threads.clear();
@@ -133,6 +136,9 @@ class ThreadPool {
     ThreadPool& operator=(ThreadPool&&)      = delete;
 
     void   start_thinking(const OptionsMap&, Position&, StateListPtr&, Search::LimitsType);
+    void   start_batch(std::shared_ptr<const std::vector<Search::BatchItem>>,
+                       std::function<void(const Search::BatchResult&)>,
+                       std::function<void()>);
     void   run_on_thread(size_t threadId, std::function<void()> f);
     void   wait_on_thread(size_t threadId);
     size_t num_threads() const;
@@ -149,11 +155,16 @@ class ThreadPool {
     void                   start_searching();
     void                   wait_for_search_finished() const;
 
-    std::vector<size_t> get_bound_thread_count_by_numa_node() const;
+    std::vector<size_t>    get_bound_thread_count_by_numa_node() const;
+    std::vector<NumaIndex> get_bound_numa_node_by_thread() const;  // Empty if not bound
+
+    // Gives back the states of the position searched last, which the search
+    // took, so that moves can be played on from it
+    StateListPtr take_setup_states() { return std::move(setupStates); }
 
     void ensure_network_replicated();
 
-    std::atomic_bool stop, abortedSearch, increaseDepth;
+    std::atomic_bool stop, abortedSearch, increaseDepth, stopAfterIteration;
 
     auto cbegin() const noexcept { return threads.cbegin(); }
     auto begin() noexcept { return threads.begin(); }
@@ -162,7 +173,45 @@ class ThreadPool {
     auto size() const noexcept { return threads.size(); }
     auto empty() const noexcept { return threads.empty(); }
 
+    // Searching on in the background after bestmove, when start_thinking()
+    // allowed it. The main thread begins it, any command ends it first.
+    bool begin_background();
+    void search_in_background();
+    void end_background();
+
    private:
+    // A root searched by some of the threads: the root of the search, or a
+    // reply of the opponent searched speculatively
+    struct SearchRoot {
+        Value              value;    // For the opponent to choose among the replies
+        size_t             threads;  // Given to it
+        StateInfo          state;
+        std::string        fen;
+        Search::RootMoves  rootMoves;
+        Tablebases::Config tbConfig;
+        Depth              depth = 0;  // Where iterative deepening starts
+    };
+
+    void add_speculative_replies(const OptionsMap&,
+                                 Position&,
+                                 const Search::SearchManager::PreviousSearch&,
+                                 int count,
+                                 std::vector<SearchRoot>&);
+    void set_roots(const std::vector<SearchRoot>&,
+                   const Search::LimitsType&,
+                   bool chess960,
+                   bool inBackground);
+
+    enum class Background {
+        Off,
+        Allowed,
+        Running
+    };
+
+    std::atomic<Background> background = Background::Off;
+    Position                backgroundPos;
+    StateInfo               backgroundStates[3];  // Of the root and after bestmove and the reply
+
     StateListPtr                         setupStates;
     std::vector<std::unique_ptr<Thread>> threads;
     std::vector<NumaIndex>               boundThreadToNumaNode;
@@ -18,17 +18,43 @@
 
 #include "tt.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cinttypes>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <numeric>
+#include <utility>
+#include <vector>
 
+#include "bitboard.h"
 #include "memory.h"
 #include "misc.h"
 #include "syzygy/tbprobe.h"
 #include "thread.h"
 
+#if defined(__linux__) && !defined(__ANDROID__)
+    #include "shm_linux.h"
+#endif
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#else
+    #define WIN32_LEAN_AND_MEAN
+    #ifndef NOMINMAX
+        #define NOMINMAX  // Disable macros min() and max()
+    #endif
+    #include <windows.h>
+#endif
+
 namespace Stockfish {
 
 
@@ -59,9 +85,14 @@ struct TTEntry {
     void save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8);
     // The returned age is a multiple of TranspositionTable::GENERATION_DELTA
     uint8_t relative_age(const uint8_t generation8) const;
+#ifdef TT_STATS
+    TTCounters::Counter save_outcome(Key k, bool pv, Bound b, Depth d, uint8_t generation8) const;
+#endif
 
    private:
     friend class TranspositionTable;
+    friend struct Cluster;
+    friend struct TTCacheEntry;
 
     uint16_t key16;
     uint8_t  depth8;
@@ -113,6 +144,24 @@ void TTEntry::save(
 }
 
 
+#ifdef TT_STATS
+// What save() does with the same arguments, checked in the same order
+TTCounters::Counter
+TTEntry::save_outcome(Key k, bool pv, Bound b, Depth d, uint8_t generation8) const {
+    if (!is_occupied())
+        return TTCounters::Filled;
+    if (uint16_t(k) != key16)
+        return relative_age(generation8) ? TTCounters::ReplacedOlder
+                                         : TTCounters::ReplacedShallower;
+    if (b == BOUND_EXACT)
+        return TTCounters::UpdatedExact;
+    if (d - DEPTH_ENTRY_OFFSET + 2 * pv > depth8 - 4)
+        return TTCounters::UpdatedDeeper;
+    return relative_age(generation8) ? TTCounters::UpdatedOlder : TTCounters::Kept;
+}
+#endif
+
+
 uint8_t TTEntry::relative_age(const uint8_t generation8) const {
     // Due to our packed storage format for generation and its cyclic
     // nature we add GENERATION_CYCLE (256 is the modulus, plus what
@@ -123,37 +172,259 @@ uint8_t TTEntry::relative_age(const uint8_t generation8) const {
 }
 
 
+// A TranspositionTable is an array of Cluster, of size clusterCount. Each cluster consists of ClusterSize number
+// of TTEntry. Each non-empty TTEntry contains information on exactly one position. The size of a Cluster should
+// divide the size of a cache line for best performance, as the cacheline is prefetched when possible.
+//
+// By default a cluster is half a cache line with 3 entries. Built with TT_CLUSTER_64, a cluster fills a whole
+// cache line with 6 entries, so that a probe reads all the line it fetches and chooses among more entries to
+// replace, at the cost of half as many clusters for the same memory.
+
+#if defined(TT_CLUSTER_64)
+static constexpr int ClusterSize  = 6;
+static constexpr int ClusterBytes = 64;
+using ClusterMeta                 = uint32_t;
+#else
+static constexpr int ClusterSize  = 3;
+static constexpr int ClusterBytes = 32;
+using ClusterMeta                 = uint16_t;
+#endif
+
+// The padding holds the epoch of the cluster, which is empty unless its
+// epoch is the one of its range.
+static constexpr int EpochBits  = 4;
+static constexpr int EpochCount = 1 << EpochBits;
+
+struct Cluster {
+    TTEntry     entry[ClusterSize];
+    ClusterMeta meta;  // Pad to ClusterBytes
+
+    uint8_t epoch() const { return uint8_t(meta & (EpochCount - 1)); }
+
+    // Empties the cluster in the given epoch
+    void reset(uint8_t e) {
+        std::memset(entry, 0, sizeof(entry));
+        meta = ClusterMeta(e);
+    }
+};
+
+static_assert(sizeof(Cluster) == ClusterBytes, "Suboptimal Cluster size");
+static_assert(EpochBits <= int(sizeof(ClusterMeta) * 8),
+              "No room left for the epoch in the padding");
+
+// Clusters of a chunk of the table, the unit of the NUMA placement. That is
+// a large page, and many small ones.
+constexpr size_t ChunkClusters = 2 * 1024 * 1024 / sizeof(Cluster);
+
+
+#ifdef TT_STATS
+namespace {
+
+// The counters of the thread, usually those of its search worker
+thread_local TTCounters* threadCounters = nullptr;
+thread_local size_t      threadNode     = 0;
+
+}  // namespace
+
+void TranspositionTable::count_on_this_thread(TTCounters* counters, size_t numaNode) {
+    threadCounters = counters;
+    threadNode     = numaNode;
+}
+#endif
+
+void TTCounters::reset() {
+    for (auto& v : value)
+        v.store(0, std::memory_order_relaxed);
+}
+
+void TTStats::add(const TTCounters& c) {
+    for (int i = 0; i < TTCounters::CounterNb; ++i)
+        counters[i] += c.get(TTCounters::Counter(i));
+
+    // A key missing from a cluster matches one of its n occupied entries
+    // by chance with a probability of about n / 2^16.
+    falseHits += double(c.get(TTCounters::MissOccupancy)) / 65536;
+}
+
+
+// An entry of a TTCache, with the 48 bits of the key that key16 lacks, and
+// the entry of the table it was read from or written to
+struct TTCacheEntry {
+    TTEntry  entry;
+    uint16_t keyMid;
+    uint32_t keyHigh;
+    TTEntry* source;
+
+    bool holds(Key k) const {
+        return entry.key16 == uint16_t(k) && keyMid == uint16_t(k >> 16)
+            && keyHigh == uint32_t(k >> 32);
+    }
+
+    void set_key(Key k) {
+        keyMid  = uint16_t(k >> 16);
+        keyHigh = uint32_t(k >> 32);
+    }
+
+    // The cache is direct-mapped, so another key always takes the entry
+    void store(Key k, const TTEntry* e) {
+        entry  = *e;
+        source = const_cast<TTEntry*>(e);
+        set_key(k);
+    }
+};
+
+static_assert(sizeof(TTCacheEntry) == 16 + sizeof(TTEntry*), "Unexpected TTCacheEntry size");
+
+
+TTCache::TTCache() = default;
+
+TTCache::~TTCache() = default;
+
+void TTCache::resize(size_t kbSize) {
+    size_t n = 0;
+    if (kbSize)
+        for (n = 1; 2 * n * sizeof(TTCacheEntry) <= kbSize * 1024;)
+            n *= 2;
+
+    entries.reset(n ? new TTCacheEntry[n]() : nullptr);
+    mask  = n ? n - 1 : 0;
+    stamp = 0;
+}
+
+void TTCache::wipe(uint32_t tableStamp) {
+    std::memset(static_cast<void*>(entries.get()), 0, (mask + 1) * sizeof(TTCacheEntry));
+    stamp = tableStamp;
+}
+
+
 // TTWriter is but a very thin wrapper around the pointer
 TTWriter::TTWriter(TTEntry* tte) :
     entry(tte) {}
 
 void TTWriter::write(
   Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8) {
+#ifdef TT_STATS
+    if (threadCounters)
+    {
+        threadCounters->add(TTCounters::Writes);
+        threadCounters->add(entry->save_outcome(k, pv, b, d, generation8));
+    }
+#endif
+
     entry->save(k, v, pv, b, d, m, ev, generation8);
 }
 
 
-// A TranspositionTable is an array of Cluster, of size clusterCount. Each cluster consists of ClusterSize number
-// of TTEntry. Each non-empty TTEntry contains information on exactly one position. The size of a Cluster should
-// divide the size of a cache line for best performance, as the cacheline is prefetched when possible.
+void TTCache::write(TTWriter& writer,
+                    Key       k,
+                    Value     v,
+                    bool      pv,
+                    Bound     b,
+                    Depth     d,
+                    Move      m,
+                    Value     ev,
+                    uint8_t   generation8) {
+    writer.write(k, v, pv, b, d, m, ev, generation8);
 
-static constexpr int ClusterSize = 3;
+    // The cache takes the entry as saved, which keeps the move and the deeper
+    // data that save() may have preserved. Later writes of other threads to
+    // the cluster are not seen there until the cache entry is replaced.
+    if (entries)
+        entries[(k >> 16) & mask].store(k, writer.entry);
+}
 
-struct Cluster {
-    TTEntry entry[ClusterSize];
-    char    padding[2];  // Pad to 32 bytes
+
+// State common to all the processes using a shared table. It takes the place
+// of the first cluster of the segment, which starts zeroed.
+struct SharedTTControl {
+    std::atomic<uint8_t> generation8;
+};
+
+static_assert(sizeof(SharedTTControl) <= sizeof(Cluster));
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+// A table in a POSIX shared memory segment. Processes attach to the same
+// segment when they use the same name and table size; the segment is removed
+// when the last of them detaches or exits.
+struct TranspositionTable::SharedTable {
+    SharedTable(const std::string& name, size_t clusterCount) :
+        region(segment_name(name, clusterCount), clusterCount + 1) {}
+
+    static std::string segment_name(const std::string& name, size_t clusterCount) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "/sf_tt_%016" PRIx64 "_%zu_%zu", hash_string(name),
+                      sizeof(Cluster), clusterCount);
+        return buf;
+    }
+
+    bool             attach() { return region.open(); }
+    Cluster*         clusters() const { return region.data() + 1; }
+    SharedTTControl* control() const { return reinterpret_cast<SharedTTControl*>(region.data()); }
+    uint32_t         users() const { return region.ref_count(); }
+
+    shm::SharedMemory<Cluster> region;
+};
+
+#else
+
+// No shared memory backend: attaching fails and the table stays private
+struct TranspositionTable::SharedTable {
+    SharedTable(const std::string&, size_t) {}
+
+    bool             attach() { return false; }
+    Cluster*         clusters() const { return nullptr; }
+    SharedTTControl* control() const { return nullptr; }
+    uint32_t         users() const { return 0; }
 };
 
-static_assert(sizeof(Cluster) == 32, "Suboptimal Cluster size");
+#endif
+
+
+TranspositionTable::TranspositionTable() = default;
+
+TranspositionTable::~TranspositionTable() { release(); }
+
+
+// Frees a private table, or detaches from a shared one
+void TranspositionTable::release() {
+    if (shared)
+        shared.reset();
+    else
+        aligned_large_pages_free(table);
+
+    table = nullptr;
+    chunkNode.clear();
+}
 
 
 // Sets the size of the transposition table,
 // measured in megabytes. Transposition table consists
 // of clusters and each cluster consists of ClusterSize number of TTEntry.
-void TranspositionTable::resize(size_t mbSize, ThreadPool& threads) {
-    aligned_large_pages_free(table);
+// With a shared name, the table is attached to the one of other processes of
+// the same name and size, or created; if that fails, a private table is used.
+void TranspositionTable::resize(size_t mbSize, ThreadPool& threads, const std::string& sharedName) {
+    release();
+    ++cacheStamp;
 
     clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+    common       = {0, clusterCount};
+
+    const auto requested = std::exchange(partitions, {});
+
+    if (!sharedName.empty())
+    {
+        auto s = std::make_unique<SharedTable>(sharedName, clusterCount);
+
+        if (s->attach())
+        {
+            shared      = std::move(s);
+            table       = shared->clusters();
+            generation8 = shared->control()->generation8.load(std::memory_order_relaxed);
+            activate(common);
+            return;
+        }
+    }
 
     table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
 
@@ -163,25 +434,125 @@ void TranspositionTable::resize(size_t mbSize, ThreadPool& threads) {
         exit(EXIT_FAILURE);
     }
 
-    clear(threads);
+    generation8 = 0;
+    activate(common);
+    place_chunks(threads);
+    clear_range(common, threads);
+
+    // Partitions are set up again with their sizes, as long as they fit
+    for (const auto& [name, p] : requested)
+        set_partition(name, p.count * sizeof(Cluster) / (1024 * 1024), threads);
 }
 
 
-// Initializes the entire transposition table to zero,
-// in a multi-threaded way.
+// Empties the transposition table, in constant time: see advance_epoch(). A
+// shared table is left as is, as other processes may be searching with it; it
+// starts zeroed when created. With partitions, only the common part is
+// cleared, and it takes back the room left by the partitions released since.
 void TranspositionTable::clear(ThreadPool& threads) {
-    generation8              = 0;
+    if (shared)
+        return;
+
+    ++cacheStamp;
+
+    const bool   commonActive = active.begin == common.begin;
+    const size_t oldCount     = common.count;
+
+    common.count = clusterCount;
+    for (const auto& [name, p] : partitions)
+        common.count = std::min(common.count, p.begin);
+
+    // The room taken back holds clusters of the epochs of the partitions
+    if (common.count > oldCount)
+        clear_range({oldCount, common.count - oldCount}, threads);
+
+    advance_epoch(common, threads);
+
+    if (commonActive)
+        activate(common);
+}
+
+
+// Empties a range by moving it to the next epoch, after which its clusters
+// count as empty, and are emptied for real on their first write. When the
+// epoch wraps around, the range is zeroed in a multi-threaded way instead,
+// so that no cluster is left with an epoch that comes back.
+void TranspositionTable::advance_epoch(TTPartition& range, ThreadPool& threads) {
+    range.epoch = uint8_t((range.epoch + 1) % EpochCount);
+
+    if (!range.epoch)
+        clear_range(range, threads);
+}
+
+
+// Makes the range the one probed by searches
+void TranspositionTable::activate(TTPartition range) {
+    active         = range;
+    activeClusters = table + range.begin;
+}
+
+
+void TranspositionTable::clear_range(TTPartition range, ThreadPool& threads) {
     const size_t threadCount = threads.num_threads();
 
+    if (chunkNode.empty())
+    {
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            threads.run_on_thread(i, [this, range, i, threadCount]() {
+                // Each thread will zero its part of the hash table
+                const size_t stride = range.count / threadCount;
+                const size_t start  = range.begin + stride * i;
+                const size_t len =
+                  i + 1 != threadCount ? stride : range.begin + range.count - start;
+
+                std::memset(&table[start], 0, len * sizeof(Cluster));
+            });
+        }
+
+        for (size_t i = 0; i < threadCount; ++i)
+            threads.wait_on_thread(i);
+
+        return;
+    }
+
+    // The chunks of a node are zeroed in turn by the threads bound to it, so
+    // that the pages touched first are placed there.
+    const auto                       nodeOf = threads.get_bound_numa_node_by_thread();
+    std::vector<std::vector<size_t>> threadsOf;
+
+    for (size_t i = 0; i < nodeOf.size(); ++i)
+    {
+        if (threadsOf.size() <= nodeOf[i])
+            threadsOf.resize(nodeOf[i] + 1);
+        threadsOf[nodeOf[i]].push_back(i);
+    }
+
+    const size_t        first = range.begin / ChunkClusters;
+    const size_t        last  = (range.begin + range.count + ChunkClusters - 1) / ChunkClusters;
+    std::vector<size_t> owner(last - first), turn(threadsOf.size());
+
+    for (size_t c = first; c < last; ++c)
+    {
+        const size_t n = chunkNode[c];
+
+        // Without a thread on its node, as the threads changed since
+        owner[c - first] = n < threadsOf.size() && !threadsOf[n].empty()
+                           ? threadsOf[n][turn[n]++ % threadsOf[n].size()]
+                           : c % threadCount;
+    }
+
     for (size_t i = 0; i < threadCount; ++i)
     {
-        threads.run_on_thread(i, [this, i, threadCount]() {
-            // Each thread will zero its part of the hash table
-            const size_t stride = clusterCount / threadCount;
-            const size_t start  = stride * i;
-            const size_t len    = i + 1 != threadCount ? stride : clusterCount - start;
+        threads.run_on_thread(i, [this, range, i, first, last, &owner]() {
+            for (size_t c = first; c < last; ++c)
+                if (owner[c - first] == i)
+                {
+                    const size_t start = std::max(range.begin, c * ChunkClusters);
+                    const size_t end = std::min(range.begin + range.count, (c + 1) * ChunkClusters);
 
-            std::memset(&table[start], 0, len * sizeof(Cluster));
+                    std::memset(&table[start], 0, (end - start) * sizeof(Cluster));
+                }
         });
     }
 
@@ -190,24 +561,326 @@ void TranspositionTable::clear(ThreadPool& threads) {
 }
 
 
+// Gives every chunk of a new table one of the NUMA nodes the threads are
+// bound to. The pages of a private table are not touched until it is first
+// cleared, by the threads of their nodes then, so that is where they land.
+void TranspositionTable::place_chunks(const ThreadPool& threads) {
+    chunkNode.clear();
+
+    std::vector<size_t> perNode = threads.get_bound_thread_count_by_numa_node();
+    std::vector<size_t> nodes;
+
+    for (size_t n = 0; n < perNode.size(); ++n)
+        if (perNode[n])
+            nodes.push_back(n);
+
+    if (nodes.size() < 2)
+        return;
+
+    const size_t chunks  = (clusterCount + ChunkClusters - 1) / ChunkClusters;
+    const size_t threadN = std::accumulate(perNode.begin(), perNode.end(), size_t(0));
+    chunkNode.resize(chunks);
+
+    if (placement == TTPlacement::Interleave)
+        for (size_t c = 0; c < chunks; ++c)
+            chunkNode[c] = uint16_t(nodes[c % nodes.size()]);
+    else
+    {
+        // As the clusters are indexed by the high bits of the keys, each node
+        // holds the keys of a range of them, sized to its share of the threads
+        size_t c = 0, threadSum = 0;
+        for (size_t n : nodes)
+        {
+            threadSum += perNode[n];
+            for (const size_t end = chunks * threadSum / threadN; c < end; ++c)
+                chunkNode[c] = uint16_t(n);
+        }
+    }
+}
+
+
+void TranspositionTable::set_placement(TTPlacement p) { placement = p; }
+
+
+// Gives a partition its own range of clusters, cleared. The range is the
+// first free one between the partitions that is large enough, or else is
+// taken from the end of the common part, which keeps at least 1 MB. The
+// entries of the common part are not moved, so most of them are lost then.
+bool TranspositionTable::set_partition(const std::string& name,
+                                       size_t             mbSize,
+                                       ThreadPool&        threads) {
+    if (shared)
+        return false;
+
+    ++cacheStamp;
+
+    const size_t count     = mbSize * 1024 * 1024 / sizeof(Cluster);
+    const size_t minCommon = 1024 * 1024 / sizeof(Cluster);
+    bool         wasActive = false;
+
+    if (auto it = partitions.find(name); it != partitions.end())
+    {
+        if (it->second.count == count)
+            return true;
+
+        wasActive = active.begin == it->second.begin;
+        partitions.erase(it);
+
+        if (wasActive)
+            activate(common);
+    }
+
+    if (!count)
+        return true;
+
+    std::vector<TTPartition> used;
+    for (const auto& [n, p] : partitions)
+        used.push_back(p);
+
+    std::sort(used.begin(), used.end(),
+              [](const TTPartition& a, const TTPartition& b) { return a.begin < b.begin; });
+
+    size_t begin = 0, cursor = common.count;
+    for (size_t i = 0; i <= used.size() && !begin; ++i)
+    {
+        const size_t end = i < used.size() ? used[i].begin : clusterCount;
+
+        if (end - cursor >= count)
+            begin = cursor;
+        else if (i < used.size())
+            cursor = used[i].begin + used[i].count;
+    }
+
+    if (!begin)
+    {
+        const size_t end = used.empty() ? clusterCount : used.front().begin;
+
+        if (end < count + minCommon)
+            return false;
+
+        begin = end - count;
+
+        const bool commonActive = active.begin == common.begin;
+
+        common.count = std::min(common.count, begin);
+
+        if (commonActive)
+            activate(common);
+    }
+
+    const TTPartition p = partitions[name] = {begin, count};
+
+    if (wasActive)
+        activate(p);
+
+    clear_range(p, threads);
+    return true;
+}
+
+
+void TranspositionTable::clear_partition(const std::string& name, ThreadPool& threads) {
+    if (auto it = partitions.find(name); it != partitions.end())
+    {
+        ++cacheStamp;
+
+        const bool wasActive = active.begin == it->second.begin;
+
+        advance_epoch(it->second, threads);
+
+        if (wasActive)
+            activate(it->second);
+    }
+}
+
+
+void TranspositionTable::select_partition(const std::string& name) {
+    auto              it   = partitions.find(name);
+    const TTPartition next = it != partitions.end() ? it->second : common;
+
+    // The caches of the threads must not carry entries across partitions
+    if (next.begin != active.begin)
+        ++cacheStamp;
+
+    activate(next);
+}
+
+
+namespace {
+
+// floor((a * b + c) / d), for a result below 2^64
+uint64_t mul_add_div(uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+#if defined(__GNUC__) && defined(IS_64BIT)
+    __extension__ using uint128 = unsigned __int128;
+    return uint64_t((uint128(a) * b + c) / d);
+#else
+    return uint64_t(((long double) a * b + c) / d);
+#endif
+}
+
+}  // namespace
+
+
+// Changes the size of the table keeping what it can of its entries. A key
+// falls in a range of n clusters at the fraction key / 2^64 of it, so the
+// cluster of an entry covers a range of fractions, which overlaps one or more
+// clusters of a range of another size. The entry keeps no more of its key, so
+// it is copied to each of them, with the replacement rule of probe(): one of
+// the copies is where probe() looks for it, and the others are soon replaced.
+// All threads copy entries, each to its part of the new table. Partitions
+// keep their size and are copied as they are.
+TTMigration TranspositionTable::migrate(size_t mbSize, ThreadPool& threads) {
+    assert(!shared);
+
+    const size_t newCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+    TTMigration  result;
+
+    if (newCount == clusterCount)
+        return result;
+
+    Cluster* fresh = static_cast<Cluster*>(aligned_large_pages_alloc(newCount * sizeof(Cluster)));
+
+    // Without room for both tables the entries are given up
+    if (!fresh)
+    {
+        resize(mbSize, threads);
+        return result;
+    }
+
+    // The caches of the threads point to entries of the old table
+    ++cacheStamp;
+
+    Cluster* const    old           = std::exchange(table, fresh);
+    const TTPartition oldCommon     = common;
+    const auto        oldPartitions = std::exchange(partitions, {});
+
+    clusterCount = newCount;
+    common = {0, clusterCount};
+    activate(common);
+    place_chunks(threads);
+    clear_range(common, threads);
+
+    for (const auto& [name, p] : oldPartitions)
+    {
+        size_t occupied = 0;
+        for (size_t i = p.begin; i < p.begin + p.count; ++i)
+            for (int j = 0; j < ClusterSize; ++j)
+                occupied += old[i].epoch() == p.epoch && old[i].entry[j].is_occupied();
+
+        result.entries += occupied;
+
+        if (set_partition(name, p.count * sizeof(Cluster) / (1024 * 1024), threads))
+        {
+            std::memcpy(&table[partitions[name].begin], &old[p.begin], p.count * sizeof(Cluster));
+            partitions[name].epoch = p.epoch;
+            result.kept += occupied;
+        }
+    }
+
+    // Returns whether the entry took an empty slot
+    auto place = [this](Cluster& cl, const TTEntry& tte) {
+        int replace = 0;
+        for (int i = 0; i < ClusterSize; ++i)
+        {
+            if (!cl.entry[i].is_occupied())
+            {
+                cl.entry[i] = tte;
+                return true;
+            }
+
+            if (cl.entry[replace].depth8 - cl.entry[replace].relative_age(generation8)
+                > cl.entry[i].depth8 - cl.entry[i].relative_age(generation8))
+                replace = i;
+        }
+
+        if (tte.depth8 - tte.relative_age(generation8)
+            > cl.entry[replace].depth8 - cl.entry[replace].relative_age(generation8))
+            cl.entry[replace] = tte;
+
+        return false;
+    };
+
+    const size_t             threadCount = threads.num_threads();
+    const uint64_t           n = oldCommon.count, m = common.count;
+    std::vector<TTMigration> counts(threadCount);
+
+    // Each thread writes a range of whole new clusters, so none is written by
+    // two threads. It reads the old clusters that overlap them, and copies their
+    // entries there. An entry is counted by the thread of its last copy.
+    for (size_t t = 0; t < threadCount; ++t)
+        threads.run_on_thread(t, [&, t]() {
+            const uint64_t stride = m / threadCount;
+            const uint64_t begin  = stride * t;
+            const uint64_t end    = t + 1 != threadCount ? begin + stride : m;
+            const uint64_t from   = mul_add_div(begin, n, 0, m);
+            const uint64_t to     = std::min(mul_add_div(end, n, m - 1, m), n);
+
+            for (uint64_t i = from; i < to; ++i)
+            {
+                const Cluster& cl = old[oldCommon.begin + i];
+
+                if (cl.epoch() != oldCommon.epoch)
+                    continue;
+
+                // The keys of the cluster lie in [i, i + 1) old clusters, that
+                // is in new clusters first to last
+                const uint64_t first = mul_add_div(i, m, 0, n);
+                const uint64_t last  = mul_add_div(i, m, m - 1, n);
+
+                for (int j = 0; j < ClusterSize; ++j)
+                {
+                    if (!cl.entry[j].is_occupied())
+                        continue;
+
+                    for (uint64_t c = std::max(first, begin); c <= last && c < end; ++c)
+                    {
+                        const bool placed = place(table[common.begin + c], cl.entry[j]);
+
+                        if (c == last)
+                        {
+                            counts[t].entries++;
+                            counts[t].kept += placed;
+                        }
+                    }
+                }
+            }
+        });
+
+    for (size_t t = 0; t < threadCount; ++t)
+    {
+        threads.wait_on_thread(t);
+        result.entries += counts[t].entries;
+        result.kept += counts[t].kept;
+    }
+
+    aligned_large_pages_free(old);
+    return result;
+}
+
+
 // Returns an approximation of the hashtable
 // occupation during a search. The hash is x permill full, as per UCI protocol.
-// Only counts entries which match the current generation.
+// Only counts entries which match the current generation. The sample is
+// 3000 entries, in the same memory whatever the cluster layout.
 int TranspositionTable::hashfull(int maxAge) const {
+    constexpr int SampleClusters = 3000 / ClusterSize;
+
     int maxAgeInternal = maxAge << GENERATION_BITS;
     int cnt            = 0;
-    for (int i = 0; i < 1000; ++i)
+    for (size_t i = active.begin; i < active.begin + SampleClusters; ++i)
         for (int j = 0; j < ClusterSize; ++j)
-            cnt += table[i].entry[j].is_occupied()
+            cnt += table[i].epoch() == active.epoch && table[i].entry[j].is_occupied()
                 && table[i].entry[j].relative_age(generation8) <= maxAgeInternal;
 
-    return cnt / ClusterSize;
+    return cnt / 3;
 }
 
 
 void TranspositionTable::new_search() {
     // increment by delta to keep lower bits as is
-    generation8 += GENERATION_DELTA;
+    if (shared)
+        generation8 = shared->control()->generation8.fetch_add(GENERATION_DELTA) + GENERATION_DELTA;
+    else
+        generation8 += GENERATION_DELTA;
 }
 
 
@@ -222,14 +895,42 @@ uint8_t TranspositionTable::generation() const { return generation8; }
 // TTEntry t2 if its replace value is greater than that of t2.
 std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) const {
 
-    TTEntry* const tte   = first_entry(key);
+    Cluster* const cl    = &activeClusters[mul_hi64(key, active.count)];
+    TTEntry* const tte   = cl->entry;
     const uint16_t key16 = uint16_t(key);  // Use the low 16 bits as key inside the cluster
 
+#ifdef TT_STATS
+    if (threadCounters)
+    {
+        threadCounters->add(TTCounters::Probes);
+
+        if (!chunkNode.empty())
+            threadCounters->add(TTCounters::RemoteProbes,
+                                chunkNode[size_t(cl - table) / ChunkClusters] != threadNode);
+    }
+#endif
+
+    // A cluster of an older epoch is empty, and is emptied for real when first probed
+    if (cl->epoch() != active.epoch)
+        cl->reset(active.epoch);
+
     for (int i = 0; i < ClusterSize; ++i)
         if (tte[i].key16 == key16)
+        {
+#ifdef TT_STATS
+            if (threadCounters && tte[i].is_occupied())
+                threadCounters->add(TTCounters::Hits);
+#endif
             // This gap is the main place for read races.
             // After `read()` completes that copy is final, but may be self-inconsistent.
             return {tte[i].is_occupied(), tte[i].read(), TTWriter(&tte[i])};
+        }
+
+#ifdef TT_STATS
+    if (threadCounters)
+        for (int j = 0; j < ClusterSize; ++j)
+            threadCounters->add(TTCounters::MissOccupancy, tte[j].is_occupied());
+#endif
 
     // Find an entry to be replaced according to the replacement strategy
     TTEntry* replace = tte;
@@ -244,8 +945,399 @@ std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) cons
 }
 
 
+// The cache of the thread is checked first, without touching the cluster. A
+// hit there writes to the entry of the table it came from, whatever that
+// holds by now.
+std::tuple<bool, TTData, TTWriter> TranspositionTable::probe_cached(const Key key,
+                                                                    TTCache&  cache) const {
+    if (cache.stamp != cacheStamp)
+        cache.wipe(cacheStamp);
+
+    TTCacheEntry& ce = cache.entries[(key >> 16) & cache.mask];
+
+    if (ce.holds(key) && ce.entry.is_occupied())
+    {
+#ifdef TT_STATS
+        if (threadCounters)
+        {
+            threadCounters->add(TTCounters::Probes);
+            threadCounters->add(TTCounters::Hits);
+            threadCounters->add(TTCounters::CacheHits);
+        }
+#endif
+        return {true, ce.entry.read(), TTWriter(ce.source)};
+    }
+
+    auto result = probe(key);
+
+    if (std::get<0>(result))
+        ce.store(key, std::get<2>(result).entry);
+
+    return result;
+}
+
+
+TTStats TranspositionTable::stats() const {
+    TTStats s{};
+
+#ifdef TT_STATS
+    s.countersEnabled = true;
+#endif
+
+    s.entries = active.count * ClusterSize;
+
+    std::vector<bool> placed;
+    for (uint16_t n : chunkNode)
+    {
+        if (placed.size() <= n)
+            placed.resize(n + 1);
+        s.numaNodes += !placed[n];
+        placed[n] = true;
+    }
+
+    for (size_t i = active.begin; i < active.begin + active.count; ++i)
+    {
+        if (table[i].epoch() != active.epoch)
+            continue;
+
+        for (const TTEntry& tte : table[i].entry)
+            if (tte.is_occupied())
+            {
+                const int depth = tte.depth8 + DEPTH_ENTRY_OFFSET;
+
+                s.occupied++;
+                s.depth[std::clamp(depth, 0, TTStats::DepthBuckets - 1)]++;
+                s.age[tte.relative_age(generation8) >> GENERATION_BITS]++;
+            }
+    }
+
+    return s;
+}
+
+
 TTEntry* TranspositionTable::first_entry(const Key key) const {
-    return &table[mul_hi64(key, clusterCount)].entry[0];
+    return &activeClusters[mul_hi64(key, active.count)].entry[0];
+}
+
+
+size_t TranspositionTable::size_mb() const { return clusterCount * sizeof(Cluster) / (1024 * 1024); }
+
+
+bool TranspositionTable::is_shared() const { return bool(shared); }
+
+
+// Number of processes attached to the shared table, this one included
+uint32_t TranspositionTable::shared_users() const { return shared ? shared->users() : 0; }
+
+
+namespace {
+
+// A saved table is made of this header, then a bitmap with one bit per entry
+// of the table telling whether the entry was saved, then the saved entries in
+// table order. Only the occupied entries
+// are stored, and a partial save keeps only the recent generations, so that
+// the file is smaller than the table.
+struct TTFileHeader {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint16_t entrySize;
+    std::uint16_t clusterBytes;
+    std::uint8_t  clusterSize;
+    std::uint8_t  generationBits;
+    std::int8_t   depthOffset;
+    std::uint8_t  generation8;
+    std::uint64_t clusterCount;
+    std::uint64_t networksHash;
+    std::uint64_t savedCount;
+};
+
+constexpr char          TTFileMagic[8]   = {'S', 'F', 'T', 'T', 'A', 'B', 'L', 'E'};
+constexpr std::uint32_t TTFileVersion    = 4;
+constexpr std::uint32_t TTFileByteOrder  = 0x01020304;
+constexpr size_t        EntriesPerWord   = 64;
+constexpr size_t        WriteBufferCount = 1 << 16;
+
+TTFileHeader file_header(size_t clusterCount, std::uint64_t networksHash, uint8_t generation8) {
+    TTFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, TTFileMagic, sizeof(h.magic));
+    h.version        = TTFileVersion;
+    h.byteOrder      = TTFileByteOrder;
+    h.entrySize      = sizeof(TTEntry);
+    h.clusterBytes   = sizeof(Cluster);
+    h.clusterSize    = ClusterSize;
+    h.generationBits = GENERATION_BITS;
+    h.depthOffset    = DEPTH_ENTRY_OFFSET;
+    h.generation8    = generation8;
+    h.clusterCount   = clusterCount;
+    h.networksHash   = networksHash;
+    return h;
+}
+
+// Read-only memory map of a whole file, so that the threads loading the
+// table fault its pages in in parallel while the kernel reads ahead.
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string& path) {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            return;
+
+        struct stat statbuf;
+        if (fstat(fd, &statbuf) == 0 && statbuf.st_size > 0)
+        {
+            void* base = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (base != MAP_FAILED)
+            {
+                data = static_cast<const char*>(base);
+                size = size_t(statbuf.st_size);
+    #if defined(MADV_SEQUENTIAL) && defined(MADV_WILLNEED)
+                madvise(base, size, MADV_SEQUENTIAL);
+                madvise(base, size, MADV_WILLNEED);
+    #endif
+            }
+        }
+        ::close(fd);
+#else
+        HANDLE fd = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fd == INVALID_HANDLE_VALUE)
+            return;
+
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(fd, &fileSize) && fileSize.QuadPart > 0)
+            mapping = CreateFileMapping(fd, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(fd);
+
+        if (mapping && (data = static_cast<const char*>(
+                          MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0))))
+            size = size_t(fileSize.QuadPart);
+#endif
+    }
+
+    ~MappedFile() {
+#ifndef _WIN32
+        if (data)
+            munmap(const_cast<char*>(data), size);
+#else
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+#endif
+    }
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data = nullptr;
+    size_t      size = 0;
+
+#ifdef _WIN32
+   private:
+    HANDLE mapping = nullptr;
+#endif
+};
+
+}  // namespace
+
+
+// Streams the table to a file. Entries older than maxAge searches are left
+// out, as they are the first to be replaced anyway.
+bool TranspositionTable::save(const std::string& path,
+                              std::uint64_t      networksHash,
+                              int                maxAge) const {
+
+    // Only the common part is saved, as a table of its size: a loaded table
+    // has no partitions.
+    const size_t entryCount = common.count * ClusterSize;
+    const int    maxAgeInternal =
+      std::min(maxAge, GENERATION_MASK >> GENERATION_BITS) << GENERATION_BITS;
+
+    std::vector<std::uint64_t> bitmap((entryCount + EntriesPerWord - 1) / EntriesPerWord);
+    TTFileHeader               header = file_header(common.count, networksHash, generation8);
+
+    for (size_t i = 0; i < entryCount; ++i)
+    {
+        const Cluster& cl  = table[i / ClusterSize];
+        const TTEntry& tte = cl.entry[i % ClusterSize];
+
+        if (cl.epoch() == common.epoch && tte.is_occupied()
+            && (maxAge < 0 || tte.relative_age(generation8) <= maxAgeInternal))
+        {
+            bitmap[i / EntriesPerWord] |= std::uint64_t(1) << (i % EntriesPerWord);
+            header.savedCount++;
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(bitmap.data()),
+               std::streamsize(bitmap.size() * sizeof(std::uint64_t)));
+
+    std::vector<TTEntry> buffer;
+    buffer.reserve(WriteBufferCount);
+
+    for (size_t w = 0; w < bitmap.size() && file; ++w)
+        for (std::uint64_t b = bitmap[w]; b; b &= b - 1)
+        {
+            const size_t i = w * EntriesPerWord + lsb(b);
+            buffer.push_back(table[i / ClusterSize].entry[i % ClusterSize]);
+
+            if (buffer.size() == WriteBufferCount)
+            {
+                file.write(reinterpret_cast<const char*>(buffer.data()),
+                           std::streamsize(buffer.size() * sizeof(TTEntry)));
+                buffer.clear();
+            }
+        }
+
+    file.write(reinterpret_cast<const char*>(buffer.data()),
+               std::streamsize(buffer.size() * sizeof(TTEntry)));
+
+    return bool(file);
+}
+
+
+// Replaces the content of the table with a saved one of the same size. The
+// file is memory mapped and, as in clear(), every thread fills its own part
+// of the table.
+TTFileStatus
+TranspositionTable::load(const std::string& path, std::uint64_t networksHash, ThreadPool& threads) {
+
+    MappedFile file(path);
+    if (!file.data)
+        return TTFileStatus::CannotOpen;
+
+    TTFileHeader header;
+    if (file.size < sizeof(header))
+        return TTFileStatus::BadFormat;
+
+    std::memcpy(&header, file.data, sizeof(header));
+
+    if (std::memcmp(header.magic, TTFileMagic, sizeof(header.magic))
+        || header.version != TTFileVersion)
+        return TTFileStatus::BadFormat;
+
+    const TTFileHeader expected = file_header(header.clusterCount, networksHash, 0);
+
+    if (header.byteOrder != expected.byteOrder || header.entrySize != expected.entrySize
+        || header.clusterBytes != expected.clusterBytes
+        || header.clusterSize != expected.clusterSize
+        || header.generationBits != expected.generationBits
+        || header.depthOffset != expected.depthOffset || !header.clusterCount)
+        return TTFileStatus::WrongLayout;
+
+    if (header.networksHash != networksHash)
+        return TTFileStatus::WrongNetworks;
+
+    const size_t entryCount = header.clusterCount * ClusterSize;
+    const size_t wordCount  = (entryCount + EntriesPerWord - 1) / EntriesPerWord;
+    const size_t entriesAt  = sizeof(header) + wordCount * sizeof(std::uint64_t);
+
+    if (file.size != entriesAt + header.savedCount * sizeof(TTEntry))
+        return TTFileStatus::Truncated;
+
+    // The size of the file is not trusted with an allocation, nor is the
+    // current table given up before the entries are known to fit.
+    if (header.clusterCount != clusterCount)
+        return TTFileStatus::WrongSize;
+
+    // The saved entries know nothing of the partitions, which are dropped
+    ++cacheStamp;
+    partitions.clear();
+    common = {0, clusterCount};
+    activate(common);
+
+    const char*  bitmap      = file.data + sizeof(header);
+    const char*  entries     = file.data + entriesAt;
+    const size_t threadCount = threads.num_threads();
+
+    // Each thread takes a range of whole clusters, and must first know how
+    // many entries were saved before its range.
+    std::vector<size_t> offsets(threadCount + 1);
+
+    auto word = [bitmap](size_t w) {
+        std::uint64_t b;
+        std::memcpy(&b, bitmap + w * sizeof(b), sizeof(b));
+        return b;
+    };
+
+    auto is_saved = [&](size_t j) {
+        return (word(j / EntriesPerWord) >> (j % EntriesPerWord)) & 1;
+    };
+
+    // In entries, starting and ending on cluster boundaries
+    auto range = [this, threadCount](size_t i) {
+        const size_t stride = clusterCount / threadCount;
+        const size_t start  = stride * i;
+        const size_t end    = i + 1 != threadCount ? start + stride : clusterCount;
+        return std::make_pair(start * ClusterSize, end * ClusterSize);
+    };
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.run_on_thread(i, [&, i]() {
+            const auto [start, end] = range(i);
+            for (size_t j = start; j < end;)
+            {
+                const size_t  next = std::min((j / EntriesPerWord + 1) * EntriesPerWord, end);
+                std::uint64_t b    = word(j / EntriesPerWord) >> (j % EntriesPerWord);
+
+                if (next - j < EntriesPerWord)
+                    b &= (std::uint64_t(1) << (next - j)) - 1;
+
+                offsets[i + 1] += popcount(b);
+                j = next;
+            }
+        });
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.wait_on_thread(i);
+
+    for (size_t i = 0; i < threadCount; ++i)
+        offsets[i + 1] += offsets[i];
+
+    if (offsets[threadCount] != header.savedCount)
+        return clear_range(common, threads), TTFileStatus::Truncated;
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.run_on_thread(i, [&, i]() {
+            const auto [start, end] = range(i);
+            const char* src         = entries + offsets[i] * sizeof(TTEntry);
+
+            for (size_t j = start; j < end; ++j)
+            {
+                Cluster&  cl   = table[j / ClusterSize];
+                const int slot = int(j % ClusterSize);
+
+                // The loaded table is in epoch 0
+                if (!slot)
+                    cl.meta = 0;
+
+                if (is_saved(j))
+                {
+                    std::memcpy(&cl.entry[slot], src, sizeof(TTEntry));
+                    src += sizeof(TTEntry);
+                }
+                else
+                    std::memset(&cl.entry[slot], 0, sizeof(TTEntry));
+            }
+        });
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.wait_on_thread(i);
+
+    generation8 = header.generation8;
+
+    if (shared)
+        shared->control()->generation8.store(generation8, std::memory_order_relaxed);
+
+    return TTFileStatus::Ok;
 }
 
 }  // namespace Stockfish
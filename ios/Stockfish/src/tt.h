@@ -19,9 +19,14 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
 #include <tuple>
+#include <vector>
 
 #include "memory.h"
 #include "types.h"
@@ -31,6 +36,8 @@ namespace Stockfish {
 class ThreadPool;
 struct TTEntry;
 struct Cluster;
+struct TTCacheEntry;
+class TTCache;
 
 // There is only one global hash table for the engine and all its threads. For chess in particular, we even allow racy
 // updates between threads to and from the TT, as taking the time to synchronize access would cost thinking time and
@@ -73,18 +80,154 @@ struct TTWriter {
 
    private:
     friend class TranspositionTable;
+    friend class TTCache;
     TTEntry* entry;
     TTWriter(TTEntry* tte);
 };
 
 
+// A small direct-mapped table of one thread, probed before the shared one.
+// It keeps whole keys, so a hit there is never a collision, and writes go
+// through to the shared table. A hit spares the probe the cluster, which
+// is often in the memory of another NUMA node or in another core's cache,
+// at the price of missing what other threads wrote there since: the cache
+// holds the entry as this thread last read or wrote it.
+class TTCache {
+   public:
+    TTCache();
+    ~TTCache();
+
+    // 0 disables the cache. The entries are allocated and zeroed by the
+    // calling thread, which should be the owner so that the memory is local.
+    void resize(size_t kbSize);
+
+    // Writes the entry, and keeps it as written if the cache is enabled
+    void write(TTWriter& writer,
+               Key       k,
+               Value     v,
+               bool      pv,
+               Bound     b,
+               Depth     d,
+               Move      m,
+               Value     ev,
+               uint8_t   generation8);
+
+   private:
+    friend class TranspositionTable;
+
+    void wipe(uint32_t tableStamp);
+
+    std::unique_ptr<TTCacheEntry[]> entries;
+    size_t                          mask  = 0;
+    uint32_t                        stamp = 0;  // Of the table when last wiped
+};
+
+
+// Outcome of TranspositionTable::migrate()
+struct TTMigration {
+    size_t entries = 0;  // Occupied entries of the old table
+    size_t kept    = 0;  // Those found in the new table
+};
+
+
+// Outcome of TranspositionTable::load()
+enum class TTFileStatus {
+    Ok,
+    CannotOpen,     // Missing or unreadable file
+    BadFormat,      // Not a saved table, or one of another format version
+    WrongLayout,    // Saved by a build with a different entry layout
+    WrongNetworks,  // Saved while other networks were loaded
+    Truncated,
+    WrongSize  // Saved with another Hash size
+};
+
+
+// Probe and write counters are compiled in debug builds only, unless
+// TT_STATS is defined.
+#if !defined(NDEBUG) && !defined(TT_STATS)
+    #define TT_STATS
+#endif
+
+// Counters of the probes and writes of one thread, see count_on_this_thread().
+// Only their thread updates them, so they need no atomic read-modify-write.
+struct TTCounters {
+    enum Counter {
+        Probes,
+        Hits,
+        CacheHits,          // Hits found in the TTCache of the thread
+        MissOccupancy,      // Occupied entries of the clusters of the misses
+        RemoteProbes,       // Clusters read on another NUMA node than the thread's
+        Writes,
+        Filled,             // An empty entry
+        ReplacedOlder,      // Another position written in an older search
+        ReplacedShallower,  // Another position of the current search
+        UpdatedExact,       // The same position, with an exact bound
+        UpdatedDeeper,
+        UpdatedOlder,
+        Kept,               // The same position, whose entry was worth more
+        CounterNb
+    };
+
+    void add(Counter c, uint64_t n = 1) {
+        value[c].store(value[c].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    uint64_t get(Counter c) const { return value[c].load(std::memory_order_relaxed); }
+    void     reset();
+
+   private:
+    std::atomic<uint64_t> value[CounterNb] = {};
+};
+
+
+// Statistics of the table, see TranspositionTable::stats(). The counters
+// are those of all the threads, and are all zero unless compiled in.
+struct TTStats {
+    static constexpr int DepthBuckets = 32;  // Depths 0 (qsearch) to 31 and above
+    static constexpr int AgeBuckets   = 32;  // Searches since the entry was written
+
+    bool     countersEnabled;
+    uint64_t counters[TTCounters::CounterNb];
+    double   falseHits;  // Estimated key16 collisions among the hits
+    size_t   numaNodes;  // The pages are placed on, 0 if left to the system
+
+    size_t   entries;  // Of the range searched, which the histograms cover
+    uint64_t occupied;
+    uint64_t depth[DepthBuckets];
+    uint64_t age[AgeBuckets];
+
+    void add(const TTCounters& c);
+};
+
+
+// How the pages of the table are spread over the NUMA nodes the search
+// threads are bound to. Each chunk of the table is first touched, so placed,
+// by a thread of its node when the table is allocated and cleared.
+enum class TTPlacement {
+    Interleave,  // The chunks go to the nodes in turn
+    Shards       // Each node takes a contiguous range, that is a range of high key bits
+};
+
+
+// A range of clusters. Searches probe only the range of the selected
+// partition, so keys of different partitions never meet.
+struct TTPartition {
+    size_t  begin;
+    size_t  count;
+    uint8_t epoch = 0;  // Clusters of another epoch are empty, see clear()
+};
+
+
 class TranspositionTable {
 
    public:
-    ~TranspositionTable() { aligned_large_pages_free(table); }
+    TranspositionTable();
+    ~TranspositionTable();
 
-    void resize(size_t mbSize, ThreadPool& threads);  // Set TT size
-    void clear(ThreadPool& threads);                  // Re-initialize memory, multithreaded
+    // Set TT size, attaching to a table shared between processes if named
+    void resize(size_t mbSize, ThreadPool& threads, const std::string& sharedName = "");
+    void clear(ThreadPool& threads);  // Re-initialize memory, multithreaded
+    TTMigration
+    migrate(size_t mbSize, ThreadPool& threads);  // Set TT size, moving the entries to the new table
     int  hashfull(int maxAge = 0)
       const;  // Approximate what fraction of entries (permille) have been written to during this root search
 
@@ -93,16 +236,69 @@ class TranspositionTable {
     uint8_t generation() const;  // The current age, used when writing new data to the TT
     std::tuple<bool, TTData, TTWriter>
     probe(const Key key) const;  // The main method, whose retvals separate local vs global objects
+    // The same, looking up the cache of the probing thread first if it is enabled
+    std::tuple<bool, TTData, TTWriter> probe(const Key key, TTCache& cache) const {
+        return cache.entries ? probe_cached(key, cache) : probe(key);
+    }
     TTEntry* first_entry(const Key key)
       const;  // This is the hash function; its only external use is memory prefetching.
 
+    bool save(const std::string& path, std::uint64_t networksHash, int maxAge)
+      const;  // Write to a file the entries at most maxAge searches old, or all if maxAge < 0
+    TTFileStatus load(const std::string& path, std::uint64_t networksHash, ThreadPool& threads);
+    size_t       size_mb() const;  // Only a file saved with this size is loaded, see load()
+
+    bool     is_shared() const;  // Attached to a table shared with other processes
+    uint32_t shared_users() const;
+
+    // Named partitions take their clusters from the end of the table, and the
+    // common part keeps the rest. Sizing a partition clears it only; mbSize 0
+    // releases it. Not available on a shared table.
+    bool set_partition(const std::string& name, size_t mbSize, ThreadPool& threads);
+    void clear_partition(const std::string& name, ThreadPool& threads);
+    void select_partition(const std::string& name);  // The common part if not found
+
+    // Applied when the table is next allocated. Threads bound to one node
+    // only, or not bound, leave the pages to the system.
+    void set_placement(TTPlacement p);
+
+    // Histograms of the entries of the range searched. The counters of the
+    // threads are added by the caller, which knows them.
+    TTStats stats() const;
+
+#ifdef TT_STATS
+    // Probes and writes made by the calling thread are counted there. The
+    // thread is bound to numaNode, if to any.
+    static void count_on_this_thread(TTCounters* counters, size_t numaNode);
+#endif
+
    private:
     friend struct TTEntry;
 
-    size_t   clusterCount;
-    Cluster* table = nullptr;
+    struct SharedTable;
+
+    std::tuple<bool, TTData, TTWriter> probe_cached(const Key key, TTCache& cache) const;
+
+    void release();
+    void activate(TTPartition range);
+    void clear_range(TTPartition range, ThreadPool& threads);
+    void advance_epoch(TTPartition& range, ThreadPool& threads);
+    void place_chunks(const ThreadPool& threads);
+
+    size_t                       clusterCount;
+    Cluster*                     table = nullptr;
+    std::unique_ptr<SharedTable> shared;
+
+    std::map<std::string, TTPartition> partitions;
+    TTPartition                        common{0, 0};
+    TTPartition                        active{0, 0};  // The range probed by searches
+    Cluster*                           activeClusters = nullptr;  // Its first cluster
+
+    TTPlacement           placement = TTPlacement::Interleave;
+    std::vector<uint16_t> chunkNode;  // NUMA node of every chunk, empty if not placed
 
-    uint8_t generation8 = 0;  // Size must be not bigger than TTEntry::genBound8
+    uint8_t  generation8 = 0;  // Size must be not bigger than TTEntry::genBound8
+    uint32_t cacheStamp  = 1;  // Changed when the caches of the threads go stale
 };
 
 }  // namespace Stockfish
@@ -19,10 +19,16 @@
 #include "uci.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <charconv>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <fstream>
+#include <iomanip>
 #include <iterator>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string_view>
@@ -43,7 +49,6 @@ namespace Stockfish {
 
 constexpr auto BenchmarkCommand = "speedtest";
 
-constexpr auto StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 template<typename... Ts>
 struct overload: Ts... {
     using Ts::operator()...;
@@ -134,7 +139,10 @@ void UCIEngine::loop() {
         else if (token == "ucinewgame")
             engine.search_clear();
         else if (token == "isready")
+        {
+            engine.load_deferred_networks();
             sync_cout << "readyok" << sync_endl;
+        }
 
         // Add custom non-UCI commands, mainly for debugging purposes.
         // These commands must not be used during a search!
@@ -144,6 +152,20 @@ void UCIEngine::loop() {
             bench(is);
         else if (token == BenchmarkCommand)
             benchmark(is);
+        else if (token == "batch")
+            batch(is);
+        else if (token == "savehash")
+            save_hash(is);
+        else if (token == "loadhash")
+            load_hash(is);
+        else if (token == "ttstats")
+            tt_stats(is);
+        else if (token == "ponderstats")
+            ponder_stats(is);
+        else if (token == "startupstats")
+            startup_stats();
+        else if (token == "evalbench")
+            eval_bench(is);
         else if (token == "d")
             sync_cout << engine.visualize() << sync_endl;
         else if (token == "eval")
@@ -152,15 +174,20 @@ void UCIEngine::loop() {
             sync_cout << compiler_info() << sync_endl;
         else if (token == "export_net")
         {
-            std::pair<std::optional<std::string>, std::string> files[2];
+            std::vector<std::string> args;
+            for (std::string arg; is >> std::skipws >> arg;)
+                args.push_back(arg);
 
-            if (is >> std::skipws >> files[0].second)
-                files[0].first = files[0].second;
+            // 'export_net image [big] [small]' saves the parameters as they are in memory
+            const bool image = !args.empty() && args[0] == "image";
+            if (image)
+                args.erase(args.begin());
 
-            if (is >> std::skipws >> files[1].second)
-                files[1].first = files[1].second;
+            std::pair<std::optional<std::string>, std::string> files[2];
+            for (size_t i = 0; i < 2 && i < args.size(); ++i)
+                files[i].first = files[i].second = args[i];
 
-            engine.save_network(files);
+            engine.save_network(files, image);
         }
         else if (token == "--help" || token == "help" || token == "--license" || token == "license")
             sync_cout
@@ -290,7 +317,13 @@ void UCIEngine::bench(std::istream& args) {
     std::cerr << "\n==========================="    //
               << "\nTotal time (ms) : " << elapsed  //
               << "\nNodes searched  : " << nodes    //
-              << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
+              << "\nNodes/second    : " << 1000 * nodes / elapsed  //
+              << "\nMemory (MB)     : " << memory_usage() / (1024 * 1024);
+
+    if (options["LowMemory"])
+        std::cerr << "\nBig net off (MB): " << engine.big_network_memory() / (1024 * 1024);
+
+    std::cerr << "\nArchitecture    : " << compiler_arch() << std::endl;
 
     // reset callback, to not capture a dangling reference to nodesSearched
     engine.set_on_update_full([&](const auto& i) { on_update_full(i, options["UCI_ShowWDL"]); });
@@ -454,6 +487,329 @@ void UCIEngine::benchmark(std::istream& args) {
     init_search_update_listeners();
 }
 
+// Reads the arguments of 'batch <file> [order input|completion] [depth N]
+// [nodes N] [movetime N]' and the positions of the file, one FEN or EPD record
+// per line. The EPD operations 'depth', 'nodes' and 'movetime' replace the
+// limits of the command for their position, other operations are ignored.
+// Positions without any limit are searched to depth 13, as in bench. Illegal
+// positions, and those with a limit out of range, are left out and returned in
+// rejected.
+std::optional<std::vector<Search::BatchItem>>
+UCIEngine::parse_batch(std::istream&             args,
+                       bool                      chess960,
+                       bool&                     inInputOrder,
+                       std::vector<std::string>& rejected,
+                       std::string&              error) {
+    std::string        path, token;
+    Search::LimitsType defaults;
+
+    auto is_number = [](const std::string& s) {
+        return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) { return std::isdigit(c); });
+    };
+
+    auto parse = [](const std::string& s, auto& value) {
+        const auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+        return ec == std::errc() && end == s.data() + s.size();
+    };
+
+    // The limits of the command are checked like those of a record, as a
+    // malformed one would otherwise leave 0, that is no limit
+    auto read_limit = [&](auto& value) {
+        std::string s;
+        return args >> s && is_number(s) && parse(s, value);
+    };
+
+    inInputOrder = true;
+    args >> path;
+
+    while (args >> token)
+        if (token == "order")
+            args >> token, inInputOrder = token != "completion";
+        else if ((token == "depth" && !read_limit(defaults.depth))
+                 || (token == "nodes" && !read_limit(defaults.nodes))
+                 || (token == "movetime" && !read_limit(defaults.movetime)))
+        {
+            error = "Invalid " + token + " limit of the batch";
+            return std::nullopt;
+        }
+
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        error = "Cannot open the batch file";
+        return std::nullopt;
+    }
+
+    std::vector<Search::BatchItem> items;
+    std::string                    line;
+
+    while (std::getline(file, line))
+    {
+        std::replace(line.begin(), line.end(), ';', ' ');
+
+        std::istringstream       ls(line);
+        std::vector<std::string> tokens{std::istream_iterator<std::string>(ls), {}};
+
+        if (tokens.size() < 4 || tokens[0][0] == '#')
+            continue;
+
+        // EPD records have no move counters, their operations follow the fourth field
+        size_t fields = 4;
+        while (fields < std::min<size_t>(6, tokens.size()) && is_number(tokens[fields]))
+            ++fields;
+
+        std::string fen = tokens[0];
+        for (size_t i = 1; i < fields; ++i)
+            fen += " " + tokens[i];
+
+        Search::LimitsType limits = defaults;
+        bool               inRange = true;
+        for (size_t i = fields; i + 1 < tokens.size(); ++i)
+            if (!is_number(tokens[i + 1]))
+                continue;
+            else if (tokens[i] == "depth")
+                inRange &= parse(tokens[i + 1], limits.depth);
+            else if (tokens[i] == "nodes")
+                inRange &= parse(tokens[i + 1], limits.nodes);
+            else if (tokens[i] == "movetime")
+                inRange &= parse(tokens[i + 1], limits.movetime);
+
+        if (!inRange)
+        {
+            rejected.push_back(fen);
+            continue;
+        }
+
+        if (!limits.depth && !limits.nodes && !limits.movetime)
+            limits.depth = 13;
+
+        StateInfo st;
+        Position  pos;
+
+        if (!pos.set_legal(fen, chess960, &st))
+            rejected.push_back(fen);
+        else
+            items.push_back({items.size(), fen, limits});
+    }
+
+    return items;
+}
+
+// Searches the positions of a file independently, each with a single thread,
+// so that every thread of the pool works on a position of its own.
+void UCIEngine::batch(std::istream& args) {
+    bool                     inInputOrder;
+    std::vector<std::string> rejected;
+    std::string              error;
+    auto                     items =
+      parse_batch(args, engine.get_options()["UCI_Chess960"], inInputOrder, rejected, error);
+
+    if (!items)
+    {
+        print_info_string(error);
+        return;
+    }
+
+    for (const auto& fen : rejected)
+        print_info_string("Skipping the invalid record " + fen);
+
+    const size_t    total    = items->size();
+    const TimePoint start    = now();
+    auto            searched = std::make_shared<std::atomic<size_t>>(0);
+
+    engine.start_batch(
+      std::move(*items), inInputOrder,
+      [searched](const Search::BatchResult& r) {
+          ++*searched;
+          sync_cout << batch_result(r) << sync_endl;
+      },
+      [searched, total, start]() {
+          sync_cout << "batchdone positions " << *searched << " of " << total << " time "
+                    << now() - start << sync_endl;
+      });
+}
+
+// savehash <file> [maxage N]: with maxage, only the entries written during the
+// last N + 1 searches are saved.
+void UCIEngine::save_hash(std::istream& args) {
+    std::string path, token;
+    int         maxAge = -1;
+
+    args >> path;
+    if (args >> token && token == "maxage")
+        args >> maxAge;
+
+    if (path.empty() || !engine.save_hash(path, maxAge))
+        print_info_string("Failed to save the hash to " + path);
+    else
+        print_info_string("Hash saved to " + path);
+}
+
+void UCIEngine::load_hash(std::istream& args) {
+    std::string path;
+    args >> path;
+
+    switch (engine.load_hash(path))
+    {
+    case TTFileStatus::Ok :
+        print_info_string("Hash loaded from " + path);
+        break;
+    case TTFileStatus::CannotOpen :
+        print_info_string("Failed to open " + path);
+        break;
+    case TTFileStatus::BadFormat :
+        print_info_string(path + " is not a saved hash of a supported version");
+        break;
+    case TTFileStatus::WrongLayout :
+        print_info_string(path + " was saved by a build with another hash entry layout");
+        break;
+    case TTFileStatus::WrongNetworks :
+        print_info_string(path + " was saved with other networks loaded");
+        break;
+    case TTFileStatus::Truncated :
+        print_info_string(path + " is truncated or corrupt");
+        break;
+    case TTFileStatus::WrongSize :
+        print_info_string(path + " was saved with another Hash size");
+        break;
+    }
+}
+
+// ttstats [reset]: occupancy, depth and age of the hash entries, then the
+// probe and write counters of debug builds, which reset clears once shown.
+void UCIEngine::tt_stats(std::istream& args) {
+    std::string token;
+    const bool  reset = args >> token && token == "reset";
+    const auto  s     = engine.get_tt_stats(reset);
+    const auto  c     = [&](TTCounters::Counter i) { return s.counters[i]; };
+
+    auto percent = [](double n, double total) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(1) << (total > 0 ? 100 * n / total : 0.0) << "%";
+        return ss.str();
+    };
+
+    std::ostringstream ss;
+    ss << "Entries: " << s.occupied << " of " << s.entries << " occupied ("
+       << percent(double(s.occupied), double(s.entries)) << ")\nDepth:";
+
+    for (int i = 0; i < TTStats::DepthBuckets; ++i)
+        if (s.depth[i])
+            ss << " " << (i == 0 ? "<=" : i == TTStats::DepthBuckets - 1 ? ">=" : "") << i << ":"
+               << s.depth[i];
+
+    ss << "\nSearches old:";
+    for (int i = 0; i < TTStats::AgeBuckets; ++i)
+        if (s.age[i])
+            ss << " " << i << ":" << s.age[i];
+
+    if (s.numaNodes)
+        ss << "\nPages placed on " << s.numaNodes << " NUMA nodes";
+
+    if (!s.countersEnabled)
+        ss << "\nProbe and write counters are only in debug builds or builds with TT_STATS";
+    else
+    {
+        const double writes = double(c(TTCounters::Writes));
+
+        ss << "\nProbes: " << c(TTCounters::Probes) << ", hits " << c(TTCounters::Hits) << " ("
+           << percent(double(c(TTCounters::Hits)), double(c(TTCounters::Probes))) << ", "
+           << c(TTCounters::CacheHits) << " in the thread caches), estimated false hits "
+           << std::fixed << std::setprecision(1) << s.falseHits
+           << "\nWrites: " << c(TTCounters::Writes) << ", filled "
+           << percent(double(c(TTCounters::Filled)), writes) << ", replaced older "
+           << percent(double(c(TTCounters::ReplacedOlder)), writes) << ", replaced shallower "
+           << percent(double(c(TTCounters::ReplacedShallower)), writes) << ", updated exact "
+           << percent(double(c(TTCounters::UpdatedExact)), writes) << ", deeper "
+           << percent(double(c(TTCounters::UpdatedDeeper)), writes) << ", older "
+           << percent(double(c(TTCounters::UpdatedOlder)), writes) << ", kept "
+           << percent(double(c(TTCounters::Kept)), writes);
+
+        if (s.numaNodes)
+            ss << "\nClusters read on another NUMA node: "
+               << percent(double(c(TTCounters::RemoteProbes)),
+                          double(c(TTCounters::Probes) - c(TTCounters::CacheHits)));
+    }
+
+    sync_cout << ss.str() << sync_endl;
+}
+
+// ponderstats [reset]: how often the ponder searches split over several
+// replies (PonderCandidates) searched the reply played, and the time spent on it
+void UCIEngine::ponder_stats(std::istream& args) {
+    std::string token;
+    const bool  reset = args >> token && token == "reset";
+    const auto  s     = engine.get_ponder_stats(reset);
+    const auto  next  = s.hits + s.alternateHits + s.misses;
+
+    auto percent = [](double n, double total) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(1) << (total > 0 ? 100 * n / total : 0.0) << "%";
+        return ss.str();
+    };
+
+    std::ostringstream ss;
+    ss << "Speculative ponders: " << s.speculations << ", reply played searched "
+       << percent(double(s.hits + s.alternateHits), double(next)) << " (expected " << s.hits
+       << ", other " << s.alternateHits << ", none " << s.misses << ")"
+       << "\nThread time on the replies played: " << s.hitTime << " of " << s.pondered << " ms ("
+       << percent(double(s.hitTime), double(s.pondered)) << ")"
+       << "\nIterations skipped by taking them over: " << s.depthTaken
+       << "\nBackground searches: " << s.backgroundSearches << ", nodes " << s.backgroundNodes
+       << ", threads busy " << s.backgroundBusy << " of " << s.backgroundTime << " ms ("
+       << percent(double(s.backgroundBusy), double(s.backgroundTime)) << ")"
+       << "\nHash written in the background: "
+       << percent(double(s.backgroundHashfull) / 1000, double(s.backgroundSearches)) << " per search"
+       << "\nPreempted by a command: " << s.preemptions << ", average "
+       << (s.preemptions ? s.preemptTime / s.preemptions : 0) << " us, max " << s.preemptMax
+       << " us";
+
+    sync_cout << ss.str() << sync_endl;
+}
+
+// startupstats: time taken to create the engine and to load the networks since
+void UCIEngine::startup_stats() {
+    const auto s  = engine.get_startup_stats();
+    auto       ms = [](std::uint64_t us) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(1) << double(us) / 1000 << " ms";
+        return ss.str();
+    };
+
+    sync_cout << "Engine created in " << ms(s.created) << "\nNetwork loads: " << s.networkLoads
+              << ", reading " << ms(s.networkRead) << ", sharing " << ms(s.networkShare)
+              << ", resetting the threads " << ms(s.threadsReset) << sync_endl;
+}
+
+// Reads 'evalbench [rounds]' and times the static evaluation of the positions
+// of the benchmark games, as stockfish_engine_evaluate() does it
+void UCIEngine::eval_bench(std::istream& args) {
+    int rounds = 20;
+    args >> rounds;
+    rounds = std::max(rounds, 1);
+
+    const auto fens = Benchmark::benchmark_positions();
+
+    if (!engine.evaluate_positions(fens))  // Warmup
+    {
+        print_info_string("The networks set by EvalFile and EvalFileSmall are not loaded");
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int r = 0; r < rounds; ++r)
+        engine.evaluate_positions(fens);
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+    sync_cout << "Positions          : " << fens.size() << " x " << rounds
+              << "\nPositions/second   : " << fens.size() * rounds * 1000000 / (elapsed + 1)
+              << sync_endl;
+}
+
 void UCIEngine::setoption(std::istringstream& is) {
     engine.wait_for_search_finished();
     engine.get_options().setoption(is);
@@ -558,12 +914,18 @@ int UCIEngine::to_cp(Value v, const Position& pos) {
     return int(std::round(100 * int(v) / a));
 }
 
-std::string UCIEngine::wdl(Value v, const Position& pos) {
-    std::stringstream ss;
-
+std::array<int, 3> UCIEngine::wdl_per_mille(Value v, const Position& pos) {
     int wdl_w = win_rate_model(v, pos);
     int wdl_l = win_rate_model(-v, pos);
     int wdl_d = 1000 - wdl_w - wdl_l;
+
+    return {wdl_w, wdl_d, wdl_l};
+}
+
+std::string UCIEngine::wdl(Value v, const Position& pos) {
+    std::stringstream ss;
+
+    auto [wdl_w, wdl_d, wdl_l] = wdl_per_mille(v, pos);
     ss << wdl_w << " " << wdl_d << " " << wdl_l;
 
     return ss.str();
@@ -611,11 +973,11 @@ Move UCIEngine::to_move(const Position& pos, std::string str) {
     return Move::none();
 }
 
-void UCIEngine::on_update_no_moves(const Engine::InfoShort& info) {
-    sync_cout << "info depth " << info.depth << " score " << format_score(info.score) << sync_endl;
+std::string UCIEngine::info_no_moves(const Engine::InfoShort& info) {
+    return "info depth " + std::to_string(info.depth) + " score " + format_score(info.score);
 }
 
-void UCIEngine::on_update_full(const Engine::InfoFull& info, bool showWDL) {
+std::string UCIEngine::info_full(const Engine::InfoFull& info, bool showWDL) {
     std::stringstream ss;
 
     ss << "info";
@@ -637,10 +999,10 @@ void UCIEngine::on_update_full(const Engine::InfoFull& info, bool showWDL) {
        << " time " << info.timeMs        //
        << " pv " << info.pv;             //
 
-    sync_cout << ss.str() << sync_endl;
+    return ss.str();
 }
 
-void UCIEngine::on_iter(const Engine::InfoIter& info) {
+std::string UCIEngine::info_iter(const Engine::InfoIter& info) {
     std::stringstream ss;
 
     ss << "info";
@@ -648,14 +1010,43 @@ void UCIEngine::on_iter(const Engine::InfoIter& info) {
        << " currmove " << info.currmove               //
        << " currmovenumber " << info.currmovenumber;  //
 
-    sync_cout << ss.str() << sync_endl;
+    return ss.str();
 }
 
-void UCIEngine::on_bestmove(std::string_view bestmove, std::string_view ponder) {
-    sync_cout << "bestmove " << bestmove;
+std::string UCIEngine::bestmove(std::string_view bestmove, std::string_view ponder) {
+    std::string str = "bestmove " + std::string(bestmove);
     if (!ponder.empty())
-        std::cout << " ponder " << ponder;
-    std::cout << sync_endl;
+        str += " ponder " + std::string(ponder);
+    return str;
+}
+
+std::string UCIEngine::batch_result(const Search::BatchResult& result) {
+    std::stringstream ss;
+
+    ss << "batch " << result.index                 //
+       << " depth " << result.depth                //
+       << " score " << format_score(result.score)  //
+       << " nodes " << result.nodes                //
+       << " time " << result.timeMs;               //
+
+    if (!result.pv.empty())
+        ss << " pv " << result.pv;
+
+    return ss.str();
+}
+
+void UCIEngine::on_update_no_moves(const Engine::InfoShort& info) {
+    sync_cout << info_no_moves(info) << sync_endl;
+}
+
+void UCIEngine::on_update_full(const Engine::InfoFull& info, bool showWDL) {
+    sync_cout << info_full(info, showWDL) << sync_endl;
+}
+
+void UCIEngine::on_iter(const Engine::InfoIter& info) { sync_cout << info_iter(info) << sync_endl; }
+
+void UCIEngine::on_bestmove(std::string_view bestmove, std::string_view ponder) {
+    sync_cout << UCIEngine::bestmove(bestmove, ponder) << sync_endl;
 }
 
 }  // namespace Stockfish
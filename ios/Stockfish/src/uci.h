@@ -19,10 +19,13 @@
 #ifndef UCI_H_INCLUDED
 #define UCI_H_INCLUDED
 
+#include <array>
 #include <cstdint>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "engine.h"
 #include "misc.h"
@@ -47,10 +50,24 @@ class UCIEngine {
     static std::string square(Square s);
     static std::string move(Move m, bool chess960);
     static std::string wdl(Value v, const Position& pos);
+    static std::array<int, 3> wdl_per_mille(Value v, const Position& pos);
     static std::string to_lower(std::string str);
     static Move        to_move(const Position& pos, std::string str);
 
     static Search::LimitsType parse_limits(std::istream& is);
+    // Returns nothing, with the reason in error, if the command is malformed or
+    // the file cannot be opened
+    static std::optional<std::vector<Search::BatchItem>> parse_batch(std::istream& args,
+                                                                     bool          chess960,
+                                                                     bool&         inInputOrder,
+                                                                     std::vector<std::string>& rejected,
+                                                                     std::string&  error);
+
+    static std::string info_no_moves(const Engine::InfoShort& info);
+    static std::string info_full(const Engine::InfoFull& info, bool showWDL);
+    static std::string info_iter(const Engine::InfoIter& info);
+    static std::string bestmove(std::string_view bestmove, std::string_view ponder);
+    static std::string batch_result(const Search::BatchResult& result);
 
     auto& engine_options() { return engine.get_options(); }
 
@@ -63,6 +80,13 @@ class UCIEngine {
     void          go(std::istringstream& is);
     void          bench(std::istream& args);
     void          benchmark(std::istream& args);
+    void          batch(std::istream& args);
+    void          save_hash(std::istream& args);
+    void          load_hash(std::istream& args);
+    void          tt_stats(std::istream& args);
+    void          ponder_stats(std::istream& args);
+    void          startup_stats();
+    void          eval_bench(std::istream& args);
     void          position(std::istringstream& is);
     void          setoption(std::istringstream& is);
     std::uint64_t perft(const Search::LimitsType&);
@@ -68,12 +68,14 @@ const Option& OptionsMap::operator[](const std::string& name) const {
 void OptionsMap::add(const std::string& name, const Option& option) {
     if (!options_map.count(name))
     {
-        static size_t insert_order = 0;
+        // The printing order is per map, so that every Engine instance
+        // numbers its own options starting from zero.
+        const size_t insert_order = options_map.size();
 
         options_map[name] = option;
 
         options_map[name].parent = this;
-        options_map[name].idx    = insert_order++;
+        options_map[name].idx    = insert_order;
     }
     else
     {
@@ -163,7 +165,8 @@ Option& Option::operator=(const std::string& v) {
         std::string        token;
         std::istringstream ss(defaultValue);
         while (ss >> token)
-            comboMap.add(token, Option());
+            if (!comboMap.count(token))  // The default value comes twice
+                comboMap.add(token, Option());
         if (!comboMap.count(v) || v == "var")
             return *this;
     }
@@ -23,3 +23,242 @@ final int Function(Pointer<Utf8>) nativeStdinWrite = _nativeLib
 final Pointer<Utf8> Function() nativeStdoutRead = _nativeLib
     .lookup<NativeFunction<Pointer<Utf8> Function()>>('stockfish_stdout_read')
     .asFunction();
+
+final Pointer<Void> Function() nativeEngineCreate = _nativeLib
+    .lookup<NativeFunction<Pointer<Void> Function()>>('stockfish_engine_create')
+    .asFunction();
+
+final void Function(Pointer<Void>) nativeEngineDestroy = _nativeLib
+    .lookup<NativeFunction<Void Function(Pointer<Void>)>>(
+        'stockfish_engine_destroy')
+    .asFunction();
+
+final int Function(Pointer<Void>, Pointer<Utf8>) nativeEngineCommand = _nativeLib
+    .lookup<NativeFunction<Int32 Function(Pointer<Void>, Pointer<Utf8>)>>(
+        'stockfish_engine_command')
+    .asFunction();
+
+final Pointer<Utf8> Function(Pointer<Void>, int) nativeEnginePoll = _nativeLib
+    .lookup<NativeFunction<Pointer<Utf8> Function(Pointer<Void>, Int32)>>(
+        'stockfish_engine_poll')
+    .asFunction();
+
+/// Mirrors `stockfish_event` in ffi.h.
+class StockfishEvent extends Struct {
+  @Uint8()
+  external int type;
+  @Uint8()
+  external int scoreType;
+  @Uint8()
+  external int bound;
+  @Uint8()
+  external int reserved;
+  @Int32()
+  external int score;
+  @Int32()
+  external int depth;
+  @Int32()
+  external int selDepth;
+  @Uint32()
+  external int multiPV;
+  @Int32()
+  external int hashfull;
+  @Array(3)
+  external Array<Uint16> wdl;
+  @Uint16()
+  external int pvLength;
+  @Uint64()
+  external int nodes;
+  @Uint64()
+  external int nps;
+  @Uint64()
+  external int tbHits;
+  @Uint64()
+  external int timeMs;
+  @Array(256)
+  external Array<Uint16> pv;
+}
+
+final int Function(Pointer<Void>, int) nativeEngineEventsOpen = _nativeLib
+    .lookup<NativeFunction<Int32 Function(Pointer<Void>, Int32)>>(
+        'stockfish_engine_events_open')
+    .asFunction();
+
+final int Function(Pointer<Void>, Pointer<StockfishEvent>, int)
+    nativeEngineEventsRead = _nativeLib
+        .lookup<
+            NativeFunction<
+                Int32 Function(Pointer<Void>, Pointer<StockfishEvent>,
+                    Int32)>>('stockfish_engine_events_read')
+        .asFunction();
+
+final int Function(Pointer<Void>) nativeEngineEventsDropped = _nativeLib
+    .lookup<NativeFunction<Int64 Function(Pointer<Void>)>>(
+        'stockfish_engine_events_dropped')
+    .asFunction();
+
+class StockfishEval extends Struct {
+  @Int32()
+  external int value;
+  @Int32()
+  external int cp;
+  @Uint8()
+  external int status;
+  @Uint8()
+  external int net;
+  @Array(2)
+  external Array<Uint8> reserved;
+}
+
+final int Function(
+        Pointer<Void>, Pointer<Pointer<Utf8>>, int, Pointer<StockfishEval>)
+    nativeEngineEvaluate = _nativeLib
+        .lookup<
+            NativeFunction<
+                Int32 Function(Pointer<Void>, Pointer<Pointer<Utf8>>, Int32,
+                    Pointer<StockfishEval>)>>('stockfish_engine_evaluate')
+        .asFunction();
+
+final int Function(Pointer<Void>, Pointer<Utf8>, int) nativeEngineSaveHash =
+    _nativeLib
+        .lookup<NativeFunction<Int32 Function(Pointer<Void>, Pointer<Utf8>, Int32)>>(
+            'stockfish_engine_save_hash')
+        .asFunction();
+
+final int Function(Pointer<Void>, Pointer<Utf8>) nativeEngineLoadHash = _nativeLib
+    .lookup<NativeFunction<Int32 Function(Pointer<Void>, Pointer<Utf8>)>>(
+        'stockfish_engine_load_hash')
+    .asFunction();
+
+class StockfishTTStats extends Struct {
+  @Uint64()
+  external int probes;
+  @Uint64()
+  external int hits;
+  @Uint64()
+  external int cacheHits;
+  @Uint64()
+  external int falseHits;
+  @Uint64()
+  external int remoteProbes;
+  @Uint64()
+  external int writes;
+  @Uint64()
+  external int filled;
+  @Uint64()
+  external int replacedOlder;
+  @Uint64()
+  external int replacedShallower;
+  @Uint64()
+  external int updatedExact;
+  @Uint64()
+  external int updatedDeeper;
+  @Uint64()
+  external int updatedOlder;
+  @Uint64()
+  external int kept;
+  @Uint64()
+  external int entries;
+  @Uint64()
+  external int occupied;
+  @Array(32)
+  external Array<Uint64> depth;
+  @Array(32)
+  external Array<Uint64> age;
+  @Uint8()
+  external int countersEnabled;
+  @Array(3)
+  external Array<Uint8> reserved;
+  @Uint32()
+  external int numaNodes;
+}
+
+final int Function(Pointer<Void>, int, Pointer<StockfishTTStats>) nativeEngineTTStats = _nativeLib
+    .lookup<NativeFunction<Int32 Function(Pointer<Void>, Int32, Pointer<StockfishTTStats>)>>(
+        'stockfish_engine_tt_stats')
+    .asFunction();
+
+class StockfishPonderStats extends Struct {
+  @Uint64()
+  external int speculations;
+  @Uint64()
+  external int hits;
+  @Uint64()
+  external int alternateHits;
+  @Uint64()
+  external int misses;
+  @Uint64()
+  external int hitTimeMs;
+  @Uint64()
+  external int ponderedMs;
+  @Uint64()
+  external int depthTaken;
+  @Uint64()
+  external int backgroundSearches;
+  @Uint64()
+  external int backgroundNodes;
+  @Uint64()
+  external int backgroundBusyMs;
+  @Uint64()
+  external int backgroundTimeMs;
+  @Uint64()
+  external int backgroundHashfull;
+  @Uint64()
+  external int preemptions;
+  @Uint64()
+  external int preemptTimeUs;
+  @Uint64()
+  external int preemptMaxUs;
+}
+
+final int Function(Pointer<Void>, int, Pointer<StockfishPonderStats>) nativeEnginePonderStats =
+    _nativeLib
+        .lookup<NativeFunction<Int32 Function(Pointer<Void>, Int32, Pointer<StockfishPonderStats>)>>(
+            'stockfish_engine_ponder_stats')
+        .asFunction();
+
+class StockfishStartupStats extends Struct {
+  @Uint64()
+  external int createdUs;
+  @Uint64()
+  external int networkLoads;
+  @Uint64()
+  external int networkReadUs;
+  @Uint64()
+  external int networkShareUs;
+  @Uint64()
+  external int threadsResetUs;
+}
+
+final int Function(Pointer<Void>, Pointer<StockfishStartupStats>) nativeEngineStartupStats =
+    _nativeLib
+        .lookup<NativeFunction<Int32 Function(Pointer<Void>, Pointer<StockfishStartupStats>)>>(
+            'stockfish_engine_startup_stats')
+        .asFunction();
+
+class StockfishPly extends Struct {
+  @Uint64()
+  external int key;
+  @Array(64)
+  external Array<Uint64> legal;
+  @Uint16()
+  external int move;
+  @Uint16()
+  external int legalCount;
+  @Uint16()
+  external int rule50;
+  @Uint8()
+  external int flags;
+  @Uint8()
+  external int reserved;
+  @Array(8)
+  external Array<Uint8> san;
+}
+
+final int Function(Pointer<Utf8>, int, Pointer<Utf8>, Pointer<StockfishPly>, int)
+    nativeBoardReplay = _nativeLib
+        .lookup<
+            NativeFunction<
+                Int32 Function(Pointer<Utf8>, Int32, Pointer<Utf8>,
+                    Pointer<StockfishPly>, Int32)>>('stockfish_board_replay')
+        .asFunction();
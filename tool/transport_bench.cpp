@@ -0,0 +1,163 @@
+// Compares the engine output transports: the former pipe read 79 bytes at a
+// time, as stockfish_stdout_read() used to do, against the LineRing drained
+// in batches. A producer thread writes 'info' lines of a realistic length at a
+// fixed rate and the consumer measures the delivery latency of every line.
+//
+// Build and run from the repository root:
+//   c++ -O2 -std=c++17 -pthread tool/transport_bench.cpp -o transport_bench
+//   ./transport_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../ios/FlutterStockfish/line_ring.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+
+  const char *Info = " depth 24 seldepth 33 multipv 1 score cp 31 nodes 24120433 nps 1202311"
+                     " hashfull 512 tbhits 0 time 20061 pv e2e4 e7e5 g1f3 b8c6 f1b5 g8f6"
+                     " e1g1 f6e4 f1e1 e4d6 f3e5 f8e7 b5f1 c6e5 e1e5 e8g8 d2d4 e7f6 e5e1";
+
+  int64_t now_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch())
+        .count();
+  }
+
+  struct Result
+  {
+    size_t lines = 0;
+    size_t reads = 0;
+    double seconds = 0;
+    std::vector<int64_t> latencies;
+  };
+
+  // Every line starts with its send time, so the consumer can measure latency
+  template <typename Write>
+  void produce(Write write, int rate, size_t count)
+  {
+    const auto start = Clock::now();
+    char line[512];
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (rate > 0)
+        std::this_thread::sleep_until(start + std::chrono::nanoseconds(int64_t(1e9) * int64_t(i) / rate));
+
+      int n = std::snprintf(line, sizeof(line), "info t=%lld%s\n", (long long)now_ns(), Info);
+      write(line, size_t(n));
+    }
+  }
+
+  void consume_lines(std::string &pending, Result &r)
+  {
+    size_t begin = 0, end;
+    while ((end = pending.find('\n', begin)) != std::string::npos)
+    {
+      const int64_t sent = std::atoll(pending.c_str() + begin + 7);
+      r.latencies.push_back(now_ns() - sent);
+      ++r.lines;
+      begin = end + 1;
+    }
+    pending.erase(0, begin);
+  }
+
+  Result run_pipe(int rate, size_t count)
+  {
+    int fds[2];
+    if (pipe(fds) != 0)
+      std::exit(EXIT_FAILURE);
+
+    Result r;
+    const auto start = Clock::now();
+
+    std::thread producer([&]()
+                         { produce([&](const char *s, size_t n)
+                                   { [[maybe_unused]] ssize_t w = write(fds[1], s, n); },
+                                   rate, count); });
+
+    char buffer[80];
+    std::string pending;
+    while (r.lines < count)
+    {
+      ssize_t n = read(fds[0], buffer, sizeof(buffer) - 1);
+      if (n <= 0)
+        break;
+      ++r.reads;
+      pending.append(buffer, size_t(n));
+      consume_lines(pending, r);
+    }
+
+    producer.join();
+    r.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    close(fds[0]);
+    close(fds[1]);
+    return r;
+  }
+
+  Result run_ring(int rate, size_t count)
+  {
+    Stockfish::LineRing ring(1 << 20);
+
+    Result r;
+    const auto start = Clock::now();
+
+    std::thread producer([&]()
+                         { produce([&](const char *s, size_t n)
+                                   { ring.write(s, n); },
+                                   rate, count); });
+
+    std::vector<char> batch;
+    std::string pending;
+    while (r.lines < count)
+    {
+      batch.clear();
+      ring.drain(batch);
+      ++r.reads;
+      pending.append(batch.data(), batch.size());
+      consume_lines(pending, r);
+    }
+
+    producer.join();
+    r.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return r;
+  }
+
+  void report(const char *name, int rate, Result r)
+  {
+    std::sort(r.latencies.begin(), r.latencies.end());
+    double mean = 0;
+    for (auto l : r.latencies)
+      mean += double(l);
+    mean /= double(std::max<size_t>(1, r.latencies.size()));
+
+    std::printf("%-5s rate %7s lines/s: %8.0f lines/s, %6.2f reads/line, latency mean %7.1f us, "
+                "p99 %7.1f us\n",
+                name, rate > 0 ? std::to_string(rate).c_str() : "max", double(r.lines) / r.seconds,
+                double(r.reads) / double(std::max<size_t>(1, r.lines)), mean / 1000,
+                double(r.latencies[r.latencies.size() * 99 / 100]) / 1000);
+  }
+
+} // namespace
+
+int main()
+{
+  for (int rate : {100, 1000, 10000, 0})
+  {
+    const size_t count = rate > 0 ? std::min(size_t(rate), size_t(20000)) : 200000;
+    report("pipe", rate, run_pipe(rate, count));
+    report("ring", rate, run_ring(rate, count));
+  }
+
+  return 0;
+}
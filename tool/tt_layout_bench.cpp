@@ -0,0 +1,203 @@
+// Compares the transposition table cluster layouts at equal memory: the
+// default 32-byte clusters of 3 entries against the 64-byte clusters of 6
+// entries of a TT_CLUSTER_64 build. The layout is chosen at compile time, so
+// the bench is built once per layout and both binaries are run with the same
+// arguments.
+//
+// Two workloads are measured on the positions of the 'bench' command:
+//  - a tree walk to a fixed depth that skips the subtrees it finds in the
+//    table, which gives the hit rate of the table under a known key stream;
+//  - fixed depth searches, which give the nps and the nodes needed to reach
+//    the depth, as the search also profits from a better table. A few
+//    positions whose trees change with the content of the table weigh much
+//    in the node count, so compare several hash sizes and depths.
+//
+// Build and run from the repository root, for example on Linux x86-64:
+//   SRC=$(find ios/Stockfish/src -name '*.cpp' ! -name main.cpp)
+//   FLAGS="-O3 -std=c++17 -pthread -DUSE_PTHREADS -DNDEBUG -DIS_64BIT -DUSE_POPCNT"
+//   FLAGS="$FLAGS -DNNUE_EMBEDDING_OFF -Iios/Stockfish/src"  # plus the SIMD flags of the target
+//   c++ $FLAGS tool/tt_layout_bench.cpp $SRC -o tt_bench_32
+//   c++ $FLAGS -DTT_CLUSTER_64 tool/tt_layout_bench.cpp $SRC -o tt_bench_64
+//   ./tt_bench_32 <big.nnue> <small.nnue> [hashMB] [threads] [depth] [walkDepth]
+//   ./tt_bench_64 <big.nnue> <small.nnue> [hashMB] [threads] [depth] [walkDepth]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "bitboard.h"
+#include "engine.h"
+#include "movegen.h"
+#include "position.h"
+#include "thread.h"
+#include "tt.h"
+#include "uci.h"
+
+using namespace Stockfish;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+
+  struct WalkResult
+  {
+    uint64_t nodes = 0;
+    uint64_t probes = 0;
+    uint64_t hits = 0;    // The key was found
+    uint64_t cutoffs = 0; // ... with enough depth to skip the subtree
+  };
+
+  // The writer is taken before the subtree is visited and used after, as in
+  // the search, so the entries stored meanwhile compete for the same slot.
+  void walk(Position &pos, TranspositionTable &tt, Depth depth, WalkResult &r)
+  {
+    ++r.nodes;
+    if (depth == 0)
+      return;
+
+    ++r.probes;
+    auto [ttHit, ttData, ttWriter] = tt.probe(pos.key());
+    if (ttHit)
+    {
+      ++r.hits;
+      if (ttData.depth >= depth)
+      {
+        ++r.cutoffs;
+        return;
+      }
+    }
+
+    StateInfo st;
+    for (const auto &m : MoveList<LEGAL>(pos))
+    {
+      pos.do_move(m, st, &tt);
+      walk(pos, tt, depth - 1, r);
+      pos.undo_move(m);
+    }
+
+    ttWriter.write(pos.key(), VALUE_ZERO, false, BOUND_EXACT, depth, Move::none(), VALUE_ZERO,
+                   tt.generation());
+  }
+
+  std::vector<std::string> bench_fens()
+  {
+    std::istringstream is("");
+    std::vector<std::string> fens;
+    for (const auto &cmd : Benchmark::setup_bench("", is))
+      if (cmd.rfind("position fen ", 0) == 0)
+        fens.push_back(cmd.substr(13));
+    return fens;
+  }
+
+  double seconds_since(Clock::time_point start)
+  {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  void run_walk(const std::vector<std::string> &fens, size_t hashMB, Depth depth)
+  {
+    // With no threads in the pool, resize() leaves the table to be cleared here
+    ThreadPool noThreads;
+    TranspositionTable tt;
+    tt.resize(hashMB, noThreads);
+    std::memset(static_cast<void *>(tt.first_entry(0)), 0, tt.size_mb() * 1024 * 1024);
+
+    WalkResult r;
+    const auto start = Clock::now();
+
+    for (const auto &fen : fens)
+    {
+      StateInfo st;
+      Position pos;
+      pos.set(fen, false, &st);
+      tt.new_search();
+      walk(pos, tt, depth, r);
+    }
+
+    const double s = seconds_since(start);
+    std::printf("walk   depth %2d: %11llu nodes, %5.1f%% hits, %5.1f%% cutoffs, %6.2f s, "
+                "hashfull %d\n",
+                int(depth), (unsigned long long)r.nodes, 100.0 * double(r.hits) / double(r.probes),
+                100.0 * double(r.cutoffs) / double(r.probes), s, tt.hashfull(4));
+  }
+
+  void run_search(const std::vector<std::string> &fens, const char *bigNet, const char *smallNet,
+                  size_t hashMB, int threads, int depth)
+  {
+    Engine engine;
+    uint64_t nodes = 0, lastNodes = 0;
+    int hashfull = 0;
+
+    engine.set_on_update_full([&](const auto &i)
+                              { lastNodes = i.nodes, hashfull = i.hashfull; });
+    engine.set_on_iter([](const auto &) {});
+    engine.set_on_update_no_moves([](const auto &) {});
+    engine.set_on_bestmove([](auto, auto) {});
+    engine.set_on_verify_networks([](auto) {});
+
+    for (const std::string &o : {"name EvalFile value " + std::string(bigNet),
+                                 "name EvalFileSmall value " + std::string(smallNet),
+                                 "name Threads value " + std::to_string(threads),
+                                 "name Hash value " + std::to_string(hashMB)})
+    {
+      std::istringstream is(o);
+      engine.get_options().setoption(is);
+    }
+
+    engine.search_clear();
+    const auto start = Clock::now();
+
+    for (const auto &fen : fens)
+    {
+      engine.set_position(fen, {});
+      std::istringstream is("depth " + std::to_string(depth));
+      Search::LimitsType limits = UCIEngine::parse_limits(is);
+      limits.startTime = now();
+      lastNodes = 0;
+      engine.go(limits);
+      engine.wait_for_search_finished();
+      nodes += lastNodes;
+    }
+
+    const double s = seconds_since(start);
+    std::printf("search depth %2d: %11llu nodes, %9.0f nps, %6.2f s, last hashfull %d\n", depth,
+                (unsigned long long)nodes, double(nodes) / s, s, hashfull);
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    std::fprintf(stderr, "Usage: %s <big.nnue> <small.nnue> [hashMB] [threads] [depth] [walkDepth]\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const size_t hashMB = argc > 3 ? size_t(std::atoi(argv[3])) : 16;
+  const int threads = argc > 4 ? std::atoi(argv[4]) : 1;
+  const int depth = argc > 5 ? std::atoi(argv[5]) : 13;
+  const int walkDepth = argc > 6 ? std::atoi(argv[6]) : 4;
+
+  Bitboards::init();
+  Position::init();
+
+#if defined(TT_CLUSTER_64)
+  std::printf("64-byte clusters of 6 entries, Hash %zu MB, %d threads\n", hashMB, threads);
+#else
+  std::printf("32-byte clusters of 3 entries, Hash %zu MB, %d threads\n", hashMB, threads);
+#endif
+
+  const std::vector<std::string> fens = bench_fens();
+  run_walk(fens, hashMB, Depth(walkDepth));
+  run_search(fens, argv[1], argv[2], hashMB, threads, depth);
+
+  return 0;
+}